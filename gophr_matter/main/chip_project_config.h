@@ -0,0 +1,12 @@
+#pragma once
+
+/*
+ * Project overrides for the CHIP stack (CONFIG_CHIP_PROJECT_CONFIG).
+ */
+
+/* Keep subscriptions in NVS so they survive deep sleep and can be resumed
+ * by the device instead of being re-established by every controller */
+#define CHIP_CONFIG_PERSIST_SUBSCRIPTIONS               1
+
+/* Keep retrying resumption with backoff if the first attempt fails */
+#define CHIP_CONFIG_SUBSCRIPTION_TIMEOUT_RESUMPTION     1
@@ -1,12 +1,17 @@
 #include "gophr_drivers.h"
+#include "gophr_energy.h"
 
 #include "driver/gpio.h"
-#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_continuous.h"
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
 #include "driver/i2c_master.h"
 #include "led_strip.h"
 #include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include <string.h>
 #include <math.h>
@@ -15,8 +20,15 @@ static const char *TAG = "gophr_drivers";
 
 /* ---------- ADC ---------- */
 
-static adc_oneshot_unit_handle_t s_adc_handle = NULL;
+/* Bytes of DMA results for one full snapshot (every channel GOPHR_ADC_OVERSAMPLE times) */
+#define ADC_FRAME_BYTES     (GOPHR_ADC_CHANNEL_COUNT * GOPHR_ADC_OVERSAMPLE * SOC_ADC_DIGI_RESULT_BYTES)
+
+/* Upper bound on one snapshot (normally ~4ms at 20kHz) */
+#define ADC_SNAPSHOT_TIMEOUT_MS     100
+
+static adc_continuous_handle_t s_adc_handle = NULL;
 static adc_cali_handle_t s_adc_cali_handle = NULL;
+static uint8_t s_adc_frame[ADC_FRAME_BYTES];
 
 /* Map GPIO number to ADC channel for ESP32-C6 ADC1 */
 static adc_channel_t gpio_to_adc_channel(int gpio_num)
@@ -33,30 +45,50 @@ static adc_channel_t gpio_to_adc_channel(int gpio_num)
     }
 }
 
-esp_err_t gophr_adc_init(void)
+static float adc_raw_to_voltage(int raw)
 {
-    adc_oneshot_unit_init_cfg_t init_cfg = {
-        .unit_id = ADC_UNIT_1,
-    };
-    ESP_RETURN_ON_ERROR(adc_oneshot_new_unit(&init_cfg, &s_adc_handle), TAG, "ADC unit init failed");
+    if (s_adc_cali_handle) {
+        int mv = 0;
+        if (adc_cali_raw_to_voltage(s_adc_cali_handle, raw, &mv) == ESP_OK) {
+            return (float)mv / 1000.0f;
+        }
+    }
 
-    /* Configure all 5 ADC channels with 12dB attenuation (0-3.3V range) */
-    adc_oneshot_chan_cfg_t chan_cfg = {
-        .atten = ADC_ATTEN_DB_12,
-        .bitwidth = ADC_BITWIDTH_12,
+    /* Fallback: linear approximation for 12-bit, 12dB attenuation */
+    return ((float)raw / 4095.0f) * 3.3f;
+}
+
+esp_err_t gophr_adc_init(void)
+{
+    adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = ADC_FRAME_BYTES * 2,
+        .conv_frame_size = ADC_FRAME_BYTES,
     };
+    ESP_RETURN_ON_ERROR(adc_continuous_new_handle(&handle_cfg, &s_adc_handle), TAG, "ADC unit init failed");
 
-    int adc_gpios[] = {
+    /* Scan all 5 ADC channels with 12dB attenuation (0-3.3V range) */
+    int adc_gpios[GOPHR_ADC_CHANNEL_COUNT] = {
         GPIO_MOISTURE_1, GPIO_MOISTURE_2, GPIO_MOISTURE_3,
         GPIO_BATTERY_VOLTAGE, GPIO_SOLAR_VOLTAGE
     };
 
-    for (int i = 0; i < 5; i++) {
-        adc_channel_t ch = gpio_to_adc_channel(adc_gpios[i]);
-        ESP_RETURN_ON_ERROR(adc_oneshot_config_channel(s_adc_handle, ch, &chan_cfg),
-                            TAG, "ADC channel %d config failed", adc_gpios[i]);
+    adc_digi_pattern_config_t pattern[GOPHR_ADC_CHANNEL_COUNT] = {0};
+    for (int i = 0; i < GOPHR_ADC_CHANNEL_COUNT; i++) {
+        pattern[i].atten = ADC_ATTEN_DB_12;
+        pattern[i].channel = gpio_to_adc_channel(adc_gpios[i]);
+        pattern[i].unit = ADC_UNIT_1;
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
     }
 
+    adc_continuous_config_t scan_cfg = {
+        .pattern_num = GOPHR_ADC_CHANNEL_COUNT,
+        .adc_pattern = pattern,
+        .sample_freq_hz = GOPHR_ADC_SAMPLE_FREQ_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE2,
+    };
+    ESP_RETURN_ON_ERROR(adc_continuous_config(s_adc_handle, &scan_cfg), TAG, "ADC scan config failed");
+
     /* Set up calibration */
     adc_cali_curve_fitting_config_t cali_cfg = {
         .unit_id = ADC_UNIT_1,
@@ -69,38 +101,56 @@ esp_err_t gophr_adc_init(void)
         s_adc_cali_handle = NULL;
     }
 
-    ESP_LOGI(TAG, "ADC initialized (5 channels, 12-bit, 12dB atten)");
+    ESP_LOGI(TAG, "ADC initialized (5 channel DMA scan, %d samples/channel, 12dB atten)",
+             GOPHR_ADC_OVERSAMPLE);
     return ESP_OK;
 }
 
-int gophr_adc_read_raw(int gpio_num)
+esp_err_t gophr_adc_read_snapshot(gophr_adc_snapshot_t *snap)
 {
-    if (!s_adc_handle) return -1;
+    for (int ch = 0; ch < GOPHR_ADC_CHANNEL_COUNT; ch++) {
+        snap->voltage[ch] = NAN;
+    }
+    if (!s_adc_handle) return ESP_ERR_INVALID_STATE;
+
+    uint32_t sum[GOPHR_ADC_CHANNEL_COUNT] = {0};
+    uint32_t count[GOPHR_ADC_CHANNEL_COUNT] = {0};
+    uint32_t total = 0;
+
+    /* Run the scan only for the duration of one snapshot */
+    adc_continuous_flush_pool(s_adc_handle);
+    ESP_RETURN_ON_ERROR(adc_continuous_start(s_adc_handle), TAG, "ADC scan start failed");
+
+    esp_err_t ret = ESP_OK;
+    while (total < GOPHR_ADC_CHANNEL_COUNT * GOPHR_ADC_OVERSAMPLE) {
+        uint32_t len = 0;
+        ret = adc_continuous_read(s_adc_handle, s_adc_frame, sizeof(s_adc_frame), &len,
+                                  ADC_SNAPSHOT_TIMEOUT_MS);
+        if (ret != ESP_OK) break;
+
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= len; i += SOC_ADC_DIGI_RESULT_BYTES) {
+            const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&s_adc_frame[i];
+            uint32_t ch = p->type2.channel;
+            if (ch >= GOPHR_ADC_CHANNEL_COUNT || count[ch] >= GOPHR_ADC_OVERSAMPLE) continue;
+            sum[ch] += p->type2.data;
+            count[ch]++;
+            total++;
+        }
+    }
+
+    adc_continuous_stop(s_adc_handle);
 
-    int raw = 0;
-    adc_channel_t ch = gpio_to_adc_channel(gpio_num);
-    esp_err_t ret = adc_oneshot_read(s_adc_handle, ch, &raw);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "ADC read GPIO%d failed: %s", gpio_num, esp_err_to_name(ret));
-        return -1;
+        ESP_LOGE(TAG, "ADC scan read failed: %s", esp_err_to_name(ret));
     }
-    return raw;
-}
 
-float gophr_adc_read_voltage(int gpio_num)
-{
-    int raw = gophr_adc_read_raw(gpio_num);
-    if (raw < 0) return NAN;
-
-    if (s_adc_cali_handle) {
-        int mv = 0;
-        if (adc_cali_raw_to_voltage(s_adc_cali_handle, raw, &mv) == ESP_OK) {
-            return (float)mv / 1000.0f;
+    /* Average in the raw domain, calibrate once per channel */
+    for (int ch = 0; ch < GOPHR_ADC_CHANNEL_COUNT; ch++) {
+        if (count[ch]) {
+            snap->voltage[ch] = adc_raw_to_voltage((int)(sum[ch] / count[ch]));
         }
     }
-
-    /* Fallback: linear approximation for 12-bit, 12dB attenuation */
-    return ((float)raw / 4095.0f) * 3.3f;
+    return ret;
 }
 
 /* ---------- I2C / AHT20 ---------- */
@@ -142,27 +192,71 @@ esp_err_t gophr_i2c_init(void)
     return ESP_OK;
 }
 
-esp_err_t gophr_aht20_read(float *temperature, float *humidity)
+/* Conversion time, busy-bit retries and retry spacing */
+#define AHT20_CONVERSION_MS     80
+#define AHT20_BUSY_RETRIES      3
+#define AHT20_BUSY_RETRY_MS     10
+
+static bool s_aht20_pending = false;
+static int64_t s_aht20_trigger_us = 0;
+
+/* CRC-8, polynomial 0x31, init 0xFF (AHT20 datasheet) */
+static uint8_t aht20_crc8(const uint8_t *data, int len)
+{
+    uint8_t crc = 0xFF;
+    for (int i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+esp_err_t gophr_aht20_trigger(void)
 {
     if (!s_aht20_dev) return ESP_ERR_INVALID_STATE;
 
-    /* Trigger measurement */
     uint8_t trigger_cmd[] = {0xAC, 0x33, 0x00};
     ESP_RETURN_ON_ERROR(i2c_master_transmit(s_aht20_dev, trigger_cmd, sizeof(trigger_cmd), 100),
                         TAG, "AHT20 trigger failed");
 
-    /* Wait for measurement (AHT20 needs ~80ms) */
-    vTaskDelay(pdMS_TO_TICKS(80));
+    s_aht20_trigger_us = esp_timer_get_time();
+    s_aht20_pending = true;
+    return ESP_OK;
+}
+
+esp_err_t gophr_aht20_collect(float *temperature, float *humidity)
+{
+    if (!s_aht20_dev) return ESP_ERR_INVALID_STATE;
+    if (!s_aht20_pending) {
+        ESP_RETURN_ON_ERROR(gophr_aht20_trigger(), TAG, "AHT20 trigger failed");
+    }
+    s_aht20_pending = false;
+
+    /* Only wait out whatever part of the conversion time has not already passed */
+    int64_t elapsed_ms = (esp_timer_get_time() - s_aht20_trigger_us) / 1000;
+    if (elapsed_ms < AHT20_CONVERSION_MS) {
+        vTaskDelay(pdMS_TO_TICKS(AHT20_CONVERSION_MS - elapsed_ms) + 1);
+    }
 
     /* Read 7 bytes: status + 20-bit humidity + 20-bit temperature + CRC */
     uint8_t data[7] = {0};
-    ESP_RETURN_ON_ERROR(i2c_master_receive(s_aht20_dev, data, sizeof(data), 100),
-                        TAG, "AHT20 read failed");
+    for (int attempt = 0; ; attempt++) {
+        ESP_RETURN_ON_ERROR(i2c_master_receive(s_aht20_dev, data, sizeof(data), 100),
+                            TAG, "AHT20 read failed");
+        if (!(data[0] & 0x80)) break;
+
+        if (attempt >= AHT20_BUSY_RETRIES) {
+            ESP_LOGW(TAG, "AHT20 still busy");
+            return ESP_ERR_NOT_FINISHED;
+        }
+        vTaskDelay(pdMS_TO_TICKS(AHT20_BUSY_RETRY_MS));
+    }
 
-    /* Check if busy */
-    if (data[0] & 0x80) {
-        ESP_LOGW(TAG, "AHT20 still busy");
-        return ESP_ERR_NOT_FINISHED;
+    if (aht20_crc8(data, 6) != data[6]) {
+        ESP_LOGW(TAG, "AHT20 CRC mismatch");
+        return ESP_ERR_INVALID_CRC;
     }
 
     /* Parse humidity (20-bit) */
@@ -177,6 +271,12 @@ esp_err_t gophr_aht20_read(float *temperature, float *humidity)
     return ESP_OK;
 }
 
+esp_err_t gophr_aht20_read(float *temperature, float *humidity)
+{
+    ESP_RETURN_ON_ERROR(gophr_aht20_trigger(), TAG, "AHT20 trigger failed");
+    return gophr_aht20_collect(temperature, humidity);
+}
+
 /* ---------- GPIO Power Control ---------- */
 
 esp_err_t gophr_gpio_init(void)
@@ -204,18 +304,21 @@ esp_err_t gophr_gpio_init(void)
 void gophr_sensor_power(bool enable)
 {
     gpio_set_level(GPIO_SENSOR_ENABLE, enable ? 1 : 0);
+    gophr_energy_load(GOPHR_LOAD_SENSOR_RAIL, enable);
     ESP_LOGI(TAG, "Sensor power %s", enable ? "ON" : "OFF");
 }
 
 void gophr_aht20_power(bool enable)
 {
     gpio_set_level(GPIO_AHT20_ENABLE, enable ? 1 : 0);
+    gophr_energy_load(GOPHR_LOAD_AHT20_RAIL, enable);
     ESP_LOGI(TAG, "AHT20 power %s", enable ? "ON" : "OFF");
 }
 
 void gophr_led_power(bool enable)
 {
     gpio_set_level(GPIO_LED_ENABLE, enable ? 1 : 0);
+    gophr_energy_load(GOPHR_LOAD_LED_RAIL, enable);
     ESP_LOGI(TAG, "LED power %s", enable ? "ON" : "OFF");
 }
 
@@ -0,0 +1,85 @@
+#include "gophr_filter.h"
+
+#include <string.h>
+#include <math.h>
+
+/* ---------- Sliding-Window Median ---------- */
+
+void gophr_median_reset(gophr_median_t *m)
+{
+    memset(m, 0, sizeof(*m));
+}
+
+float gophr_median_push(gophr_median_t *m, float sample)
+{
+    int n = m->count;
+    int pos;
+
+    if (n == MEDIAN_FILTER_WINDOW) {
+        /* Window full: overwrite the oldest sample's slot in the sorted array */
+        float oldest = m->ring[m->head];
+        pos = 0;
+        while (pos < n - 1 && m->sorted[pos] != oldest) pos++;
+    } else {
+        /* Still filling: append at the end */
+        pos = n++;
+        m->count = (uint8_t)n;
+    }
+
+    /* Slide the new sample into place (only one of these loops moves) */
+    while (pos > 0 && m->sorted[pos - 1] > sample) {
+        m->sorted[pos] = m->sorted[pos - 1];
+        pos--;
+    }
+    while (pos < n - 1 && m->sorted[pos + 1] < sample) {
+        m->sorted[pos] = m->sorted[pos + 1];
+        pos++;
+    }
+    m->sorted[pos] = sample;
+
+    m->ring[m->head] = sample;
+    m->head = (uint8_t)((m->head + 1) % MEDIAN_FILTER_WINDOW);
+
+    return m->sorted[n / 2];
+}
+
+/* ---------- Filter Chain ---------- */
+
+void gophr_filter_reset(gophr_filter_t *f)
+{
+    memset(f, 0, sizeof(*f));
+}
+
+gophr_filter_result_t gophr_filter_push(gophr_filter_t *f, const gophr_filter_cfg_t *cfg,
+                                        float sample, float *out)
+{
+    /* skip_initial */
+    if (f->skipped < cfg->skip_initial) {
+        f->skipped++;
+        return GOPHR_FILTER_SKIPPED;
+    }
+
+    /* Range gate (also drops NaN) */
+    if (!(sample >= cfg->min_value && sample <= cfg->max_value)) {
+        return GOPHR_FILTER_REJECTED;
+    }
+
+    /* Median */
+    float value = gophr_median_push(&f->median, sample);
+
+    /* Delta: hold until the median moves far enough from the last published one */
+    if (f->has_output && cfg->delta > 0.0f && fabsf(value - f->last_median) <= cfg->delta) {
+        return GOPHR_FILTER_UNCHANGED;
+    }
+    f->last_median = value;
+
+    /* EMA */
+    if (f->has_output) {
+        value = f->output + cfg->ema_alpha * (value - f->output);
+    }
+    f->output = value;
+    f->has_output = true;
+
+    *out = value;
+    return GOPHR_FILTER_PUBLISH;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Median filter window size (compile-time; override with -DMEDIAN_FILTER_WINDOW=N) */
+#ifndef MEDIAN_FILTER_WINDOW
+#define MEDIAN_FILTER_WINDOW    5
+#endif
+
+#if MEDIAN_FILTER_WINDOW < 1 || MEDIAN_FILTER_WINDOW > 255
+#error "MEDIAN_FILTER_WINDOW must be 1..255"
+#endif
+
+/*
+ * Sliding-window median.
+ * Keeps the window both in arrival order (ring) and ascending order (sorted),
+ * so each new sample evicts the oldest one and is placed with a single
+ * O(window) shift instead of a full sort.
+ */
+typedef struct {
+    float ring[MEDIAN_FILTER_WINDOW];
+    float sorted[MEDIAN_FILTER_WINDOW];
+    uint8_t head;
+    uint8_t count;
+} gophr_median_t;
+
+/* Clear the window */
+void gophr_median_reset(gophr_median_t *m);
+
+/* Add a sample (must not be NaN), return the median of the current window */
+float gophr_median_push(gophr_median_t *m, float sample);
+
+/*
+ * Moisture filter chain, mirroring the ESPHome sensor filters:
+ *   skip_initial -> range gate -> median -> delta -> EMA
+ * All stages run in one pass over a per-channel state block. A stage is
+ * disabled by its neutral setting (skip_initial 0, delta 0, ema_alpha 1).
+ */
+typedef struct {
+    uint16_t skip_initial;  /* Samples dropped after reset */
+    float min_value;        /* Range gate, inclusive */
+    float max_value;
+    float delta;            /* Minimum change from last output to publish */
+    float ema_alpha;        /* Weight of the new value (1.0 = no smoothing) */
+} gophr_filter_cfg_t;
+
+/* ESPHome parity: skip_initial 10, 0-3.3V gate, median, delta 0.01V */
+#define GOPHR_FILTER_CFG_MOISTURE_DEFAULT()                     \
+    {                                                           \
+        .skip_initial = 10,                                     \
+        .min_value = 0.0f,                                      \
+        .max_value = 3.3f,                                      \
+        .delta = 0.01f,                                         \
+        .ema_alpha = 1.0f,                                      \
+    }
+
+typedef struct {
+    gophr_median_t median;
+    uint16_t skipped;
+    bool has_output;
+    float last_median;      /* Last median value that passed the delta stage */
+    float output;           /* Last published value (after EMA) */
+} gophr_filter_t;
+
+/* Result of pushing one sample through the chain */
+typedef enum {
+    GOPHR_FILTER_PUBLISH = 0,   /* New output value available */
+    GOPHR_FILTER_SKIPPED,       /* Dropped by skip_initial */
+    GOPHR_FILTER_REJECTED,      /* Dropped by range gate (NaN/out-of-range) */
+    GOPHR_FILTER_UNCHANGED,     /* Held by delta stage */
+} gophr_filter_result_t;
+
+/* Reset a channel's chain state (skip_initial starts over) */
+void gophr_filter_reset(gophr_filter_t *f);
+
+/* Run one raw sample through the chain; *out is set on GOPHR_FILTER_PUBLISH */
+gophr_filter_result_t gophr_filter_push(gophr_filter_t *f, const gophr_filter_cfg_t *cfg,
+                                        float sample, float *out);
+
+#ifdef __cplusplus
+}
+#endif
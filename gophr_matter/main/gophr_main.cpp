@@ -6,17 +6,27 @@
  * Uses same GPIO pin mapping as original ESP32-C3 PCB design.
  *
  * Commissioning: BLE is used for initial pairing, then Thread for communication.
+ * BLE is shut down and its memory released once the device is commissioned.
  */
 
 extern "C" {
 #include "gophr_drivers.h"
 #include "gophr_sensors.h"
 #include "gophr_sleep.h"
+#include "gophr_sched.h"
+#include "gophr_wakegate.h"
+#include "gophr_samplelog.h"
+#include "gophr_persist.h"
+#include "gophr_trace.h"
+#include "gophr_energy.h"
 }
 #include "gophr_matter.h"
 
 #include <esp_log.h>
+#include <esp_attr.h>
+#include <esp_pm.h>
 #include <nvs_flash.h>
+#include <time.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <esp_matter.h>
@@ -25,18 +35,16 @@ static const char *TAG = "gophr_main";
 
 static bool s_boot_complete = false;
 
-/* ---------- Sensor Reading Task ---------- */
+/* Warm wake: how long to wait for the network before giving up on the fast path */
+#define WARM_JOIN_TIMEOUT_MS    10000
 
-static void sensor_task(void *pvParameters)
+/* Cold boot: power all rails, LED boot indicator, wait for the probes to settle */
+static void boot_sequence(void)
 {
-    /* Boot sequence: match original ESPHome behavior */
     ESP_LOGI(TAG, "Boot sequence: powering on sensors...");
     gophr_sensor_power(true);
-    vTaskDelay(pdMS_TO_TICKS(30000)); /* Wait 30s for sensors to stabilize */
-
     gophr_aht20_power(true);
     gophr_led_power(true);
-    vTaskDelay(pdMS_TO_TICKS(15000)); /* Wait 15s */
 
     /* Init LED and set blue (boot indicator) */
     gophr_led_init();
@@ -45,82 +53,283 @@ static void sensor_task(void *pvParameters)
     /* Init I2C for AHT20 (after power enabled) */
     gophr_i2c_init();
 
-    /* Wait for moisture sensors to read > 0.9V (30s timeout) */
+    /* Wait for moisture readings to settle (30s timeout) */
     ESP_LOGI(TAG, "Waiting for moisture sensors to stabilize...");
+    if (gophr_sensors_wait_settled(SETTLE_TIMEOUT_MS) == ESP_OK) {
+        ESP_LOGI(TAG, "All moisture sensors ready");
+    } else {
+        ESP_LOGW(TAG, "Moisture sensor timeout - continuing anyway");
+    }
+}
+
+/* ---------- Offline Sample Log ---------- */
+
+#define BACKFILL_FRAMES_PER_WINDOW  4       /* Backlog frames sent per sensor window */
+#define BACKFILL_GAP_MS             250     /* Pause between backlog frames */
+
+/* Keep a reading that could not go out; it is streamed once back on the network */
+static void log_offline_sample(const sensor_readings_t *readings)
+{
+    gophr_sample_t sample = {};
+    sample.time_s = (uint32_t)time(NULL);
+    for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
+        sample.moisture[i] = (uint16_t)(readings->moisture_percent[i] * 100.0f);
+    }
+    sample.temperature = (int16_t)(readings->temperature * 100.0f);
+    sample.humidity = (uint16_t)(readings->humidity * 100.0f);
+    sample.battery_mv = (uint16_t)(readings->battery_voltage * 1000.0f);
+    gophr_samplelog_append(&sample);
+}
+
+/* Last seq logged as an event this connection; resent from the ack after a drop or a reboot */
+static uint32_t s_backlog_sent;
+
+/*
+ * Stream part of the backlog, oldest first; a few frames per window keeps
+ * the radio duty low. Samples leave the log only once the controller has
+ * written back the last seq it stored.
+ */
+static void backfill(void)
+{
+    gophr_samplelog_ack(gophr_matter_backlog_acked());
+
+    gophr_sample_t samples[GOPHR_MATTER_BACKLOG_PER_EVENT];
+    for (int f = 0; f < BACKFILL_FRAMES_PER_WINDOW && gophr_matter_is_connected(); f++) {
+        int n = gophr_samplelog_peek_after(s_backlog_sent, samples, GOPHR_MATTER_BACKLOG_PER_EVENT);
+        if (!n) break;
+        if (gophr_matter_send_backlog(samples, n) != ESP_OK) break;
+        s_backlog_sent = samples[n - 1].seq;
+        vTaskDelay(pdMS_TO_TICKS(BACKFILL_GAP_MS));
+    }
+}
+
+/* ---------- Wake Gating ---------- */
+
+/* Survives deep sleep: moisture last reported and wakes skipped since */
+static RTC_DATA_ATTR gophr_wakegate_t s_wakegate;
+
+static void gate_moisture(const sensor_readings_t *readings, uint16_t out[GOPHR_WAKEGATE_CHANNELS])
+{
+    for (int i = 0; i < GOPHR_WAKEGATE_CHANNELS; i++) {
+        out[i] = (uint16_t)(readings->moisture_percent[i] * 100.0f);
+    }
+}
+
+/*
+ * Every subscriber acked the current moisture attributes: next wakes compare
+ * against them. These are the data model values, which the deadbands may
+ * hold back from the latest reading, and never ones still in flight.
+ */
+static void gate_reported(uint32_t timeout_ms)
+{
+    uint16_t moisture[GOPHR_WAKEGATE_CHANNELS];
+    if (gophr_matter_flush_reports(timeout_ms, moisture) == ESP_OK) {
+        gophr_wakegate_reported(&s_wakegate, moisture);
+    }
+}
+
+/*
+ * Warm wake, before the radio starts: take the moisture sample and go
+ * straight back to sleep if no channel moved far enough. Returns only if
+ * this wake should report.
+ */
+static void gate_warm_wake(void)
+{
+    gophr_sensor_power(true);
+    gophr_aht20_power(true);
+    gophr_i2c_init();
+
+    if (gophr_sensors_wait_settled(SETTLE_TIMEOUT_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "Moisture sensor timeout - sampling anyway");
+    }
+    gophr_sensors_read_burst();
+
+    sensor_readings_t readings;
+    gophr_sensors_get_readings(&readings);
+    uint16_t moisture[GOPHR_WAKEGATE_CHANNELS];
+    gate_moisture(&readings, moisture);
+
+    int duration = gophr_sleep_get_interval();
+    int max_skips = GOPHR_WAKEGATE_MAX_INTERVAL_MIN / (duration > 0 ? duration : 1) - 1;
+    gophr_wakegate_cfg_t cfg = {
+        .delta = GOPHR_WAKEGATE_DELTA,
+        .max_skips = (uint16_t)(max_skips > 0 ? max_skips : 0),
+    };
+    if (!gophr_wakegate_sample(&s_wakegate, &cfg, moisture)) {
+        gophr_sleep_skip_wake();
+    }
+}
+
+/*
+ * Warm (timer) wake: no LED, one filtered measurement set, push it and go
+ * straight back to sleep. Returns only if the device could not sleep again.
+ */
+static void warm_wake_cycle(void)
+{
+    ESP_LOGI(TAG, "Warm wake: measure -> report -> sleep");
+
+    /* Moisture was sampled by the wake gate; rails and I2C are already up */
+    gophr_sensors_trigger_aht20();
+    gophr_sensors_read_aht20();
+
+    /* The stack restores the network from NVS; give it a bounded time to rejoin */
     uint32_t wait_start = xTaskGetTickCount();
-    bool sensors_ready = false;
-
-    while (!sensors_ready && ((xTaskGetTickCount() - wait_start) * portTICK_PERIOD_MS < 30000)) {
-        gophr_sensors_read_moisture();
-        const sensor_readings_t *r = gophr_sensors_get_readings();
-
-        sensors_ready = true;
-        for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
-            if (r->moisture_voltage[i] < 0.9f) {
-                sensors_ready = false;
-                break;
-            }
-        }
+    while (!gophr_matter_is_connected() &&
+           (xTaskGetTickCount() - wait_start) * portTICK_PERIOD_MS < WARM_JOIN_TIMEOUT_MS) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    if (!gophr_matter_is_connected()) {
+        ESP_LOGW(TAG, "Not back on the network - staying awake");
+        sensor_readings_t readings;
+        gophr_sensors_get_readings(&readings);
+        log_offline_sample(&readings);
+        return;
+    }
+
+    sensor_readings_t readings;
+    gophr_sensors_get_readings(&readings);
+    gophr_matter_update_readings(&readings, GOPHR_MATTER_UPDATE_ALL);
+    gophr_energy_summary_t energy;
+    gophr_energy_get(&energy);
+    gophr_matter_update_energy(&energy);
+
+    /* The sleep sequence's own flush then returns right away */
+    gate_reported(GOPHR_MATTER_FLUSH_TIMEOUT_MS);
+    gophr_sleep_now();
+}
+
+/* Sensor rail dropped between windows; it has to settle again when it comes back */
+static bool s_sensor_rail_idle;
 
-        if (!sensors_ready) {
-            vTaskDelay(pdMS_TO_TICKS(1000));
+/* Make sure the rails a window needs are up (the sleep path may have dropped them) */
+static void power_rails(uint32_t rails)
+{
+    if (rails & GOPHR_RAIL_SENSOR) {
+        gophr_sensor_power(true);
+        if (s_sensor_rail_idle && gophr_sensors_wait_settled(RESETTLE_TIMEOUT_MS) != ESP_OK) {
+            ESP_LOGD(TAG, "Moisture not settled after rail power-up - sampling anyway");
         }
+        s_sensor_rail_idle = false;
     }
+    if (rails & GOPHR_RAIL_AHT20) gophr_aht20_power(true);
+}
 
-    if (sensors_ready) {
-        ESP_LOGI(TAG, "All moisture sensors ready");
+/*
+ * After a window: drop the sensor rail (probes + dividers) when no window
+ * needs it soon. The AHT20 stays up, it idles below 1uA and re-powering it
+ * would need an I2C re-init.
+ */
+static void idle_rails(void)
+{
+    if (!s_sensor_rail_idle && (gophr_sched_idle_rails() & GOPHR_RAIL_SENSOR)) {
+        gophr_sensor_power(false);
+        s_sensor_rail_idle = true;
+    }
+}
+
+/* ---------- Sensor Reading Task ---------- */
+
+static void sensor_task(void *pvParameters)
+{
+    if (gophr_sleep_is_warm_wake()) {
+        warm_wake_cycle();
     } else {
-        ESP_LOGW(TAG, "Moisture sensor timeout - continuing anyway");
+        boot_sequence();
     }
 
     s_boot_complete = true;
     ESP_LOGI(TAG, "Boot complete");
 
     /* ---------- Main sensor loop ---------- */
-    uint32_t loop_count = 0;
-    const uint32_t MOISTURE_INTERVAL_MS = 5000;   /* Read moisture every 5s */
-    const uint32_t AHT20_INTERVAL_LOOPS = 12;     /* Read AHT20 every 60s (12 * 5s) */
-    const uint32_t POWER_INTERVAL_LOOPS = 6;      /* Read power every 30s (6 * 5s) */
-    const uint32_t SLEEP_CHECK_LOOPS = 6;         /* Check sleep every 30s */
+    /* Moisture every 5s, AHT20 every 60s, power and sleep check every 30s (gophr_sched.h) */
+    ESP_ERROR_CHECK(gophr_sched_init(NULL));
 
     while (1) {
-        /* Read moisture sensors every loop (5s) */
-        gophr_sensors_read_moisture();
-        const sensor_readings_t *readings = gophr_sensors_get_readings();
+        /* Block (light sleep) until the next window of due jobs */
+        uint32_t jobs = gophr_sched_wait();
+        bool read_moisture = jobs & GOPHR_JOB_BIT(GOPHR_JOB_MOISTURE);
+        bool read_power = jobs & GOPHR_JOB_BIT(GOPHR_JOB_POWER);
+        bool read_aht20 = jobs & GOPHR_JOB_BIT(GOPHR_JOB_AHT20);
 
-        /* Update Matter moisture attributes */
-        for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
-            gophr_matter_update_moisture(i, readings->moisture_percent[i]);
+        power_rails(gophr_sched_rails(jobs));
+
+        /* Start the AHT20 conversion first so it overlaps the ADC scan */
+        if (read_aht20) {
+            gophr_sensors_trigger_aht20();
         }
 
-        /* Read AHT20 every 60s */
-        if (loop_count % AHT20_INTERVAL_LOOPS == 0) {
-            if (gophr_sensors_read_aht20() == ESP_OK) {
-                gophr_matter_update_temperature(readings->temperature);
-                gophr_matter_update_humidity(readings->humidity);
-            }
+        /* Battery/solar come from the same scan as moisture */
+        if (read_power) {
+            gophr_sensors_read_adc();
+        } else if (read_moisture) {
+            gophr_sensors_read_moisture();
         }
+        bool aht20_ok = read_aht20 && gophr_sensors_read_aht20() == ESP_OK;
+
+        sensor_readings_t readings;
+        gophr_sensors_get_readings(&readings);
 
-        /* Read power every 30s */
-        if (loop_count % POWER_INTERVAL_LOOPS == 0) {
-            gophr_sensors_read_power();
-            gophr_matter_update_battery(readings->battery_voltage, readings->battery_percent);
+        /* Push this window's readings in one batched update */
+        uint32_t fields = 0;
+        if (read_moisture || read_power) {
+            fields |= GOPHR_MATTER_UPDATE_MOISTURE;
+        }
+        if (aht20_ok) fields |= GOPHR_MATTER_UPDATE_CLIMATE;
+        if (read_power) fields |= GOPHR_MATTER_UPDATE_BATTERY;
+        gophr_matter_update_readings(&readings, fields);
+
+        if (read_power) {
+            gophr_energy_summary_t energy;
+            gophr_energy_get(&energy);
+            gophr_matter_update_energy(&energy);
         }
 
-        /* Check sleep every 30s */
-        if (loop_count % SLEEP_CHECK_LOOPS == 0) {
+        /* Move the gate once the subscribers have acked the moisture (check only, no wait) */
+        if ((fields & GOPHR_MATTER_UPDATE_MOISTURE) && gophr_matter_is_connected()) {
+            gate_reported(0);
+        }
+
+        /* Off the network: log a sample per power window; back on it: catch up */
+        if (!gophr_matter_is_connected()) {
+            if (read_power) log_offline_sample(&readings);
+            s_backlog_sent = 0;     /* Unacked events may be gone with the subscription */
+        } else if (gophr_samplelog_pending()) {
+            backfill();
+        }
+
+        if (jobs & GOPHR_JOB_BIT(GOPHR_JOB_SLEEP)) {
             gophr_sleep_check();
         }
 
-        loop_count++;
-        vTaskDelay(pdMS_TO_TICKS(MOISTURE_INTERVAL_MS));
+        idle_rails();
     }
 }
 
+/* ---------- Power Management ---------- */
+
+/* Automatic light sleep whenever all tasks are blocked (tickless idle) */
+static esp_err_t power_save_init(void)
+{
+#ifdef CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    return esp_pm_configure(&pm_config);
+#else
+    return ESP_OK;
+#endif
+}
+
 /* ---------- App Main ---------- */
 
 extern "C" void app_main(void)
 {
+    gophr_trace_start();
+    gophr_trace_mark(GOPHR_PHASE_BOOT);
     ESP_LOGI(TAG, "=== Gophr Matter Sensor v1.0.0 ===");
     ESP_LOGI(TAG, "ESP32-C6 | Matter over Thread");
 
@@ -132,20 +341,39 @@ extern "C" void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
+    /* Settings and calibration are written behind, coalesced over a window */
+    ESP_ERROR_CHECK(gophr_persist_init(GOPHR_PERSIST_WINDOW_MS));
+
+    ESP_ERROR_CHECK(power_save_init());
+
+    /* Energy ledger: opens this cycle with the deep sleep before it, if any */
+    ESP_ERROR_CHECK(gophr_energy_init(NULL));
+
     /* Initialize hardware */
     ESP_ERROR_CHECK(gophr_gpio_init());
     ESP_ERROR_CHECK(gophr_adc_init());
 
-    /* Initialize sensor subsystem (loads calibration from NVS) */
+    /* Initialize sleep subsystem first: it decides whether this is a warm wake */
+    ESP_ERROR_CHECK(gophr_sleep_init());
+
+    /* Initialize sensor subsystem (loads calibration from NVS, or RTC on warm wake) */
     ESP_ERROR_CHECK(gophr_sensors_init());
+    gophr_trace_mark(GOPHR_PHASE_INIT);
 
-    /* Initialize sleep subsystem (loads config from NVS) */
-    ESP_ERROR_CHECK(gophr_sleep_init());
+    /* Samples logged while off the network (runs without it if the partition is missing) */
+    gophr_samplelog_init();
+
+    /* Warm wake with unchanged soil goes back to sleep here, before the radio starts */
+    if (gophr_sleep_is_warm_wake()) {
+        gate_warm_wake();
+    }
 
     /* Initialize Matter data model (creates node + endpoints) */
     ESP_ERROR_CHECK(gophr_matter_init());
 
     /* Start the Matter stack */
+    gophr_trace_mark(GOPHR_PHASE_STACK);
+    gophr_energy_load(GOPHR_LOAD_RADIO, true);
     ESP_ERROR_CHECK(esp_matter::start(NULL));
     ESP_LOGI(TAG, "Matter stack started");
 
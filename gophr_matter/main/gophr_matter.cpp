@@ -1,13 +1,25 @@
 #include "gophr_matter.h"
 #include "gophr_drivers.h"
+#include "gophr_sleep.h"
+#include "gophr_trace.h"
 
 #include <esp_log.h>
+#include <string.h>
+#include <time.h>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <esp_matter.h>
 #include <esp_matter_endpoint.h>
 #include <esp_matter_cluster.h>
 #include <esp_matter_attribute.h>
+#if CONFIG_ENABLE_ICD_SERVER
+#include <esp_matter_icd_configuration.h>
+#endif
 
 #include <app/server/Server.h>
+#include <app/InteractionModelEngine.h>
+#include <app/EventLogging.h>
 #include <platform/CHIPDeviceLayer.h>
 #include <app/clusters/temperature-measurement-server/temperature-measurement-server.h>
 
@@ -23,6 +35,50 @@ static uint16_t s_temp_ep_id = 0;
 static uint16_t s_humidity_ep_id = 0;
 static uint16_t s_moisture_ep_ids[3] = {0};
 static bool s_connected = false;
+static bool s_subscriptions_resumed = false;
+
+/* Report deadbands (CHIP thread only) */
+typedef struct {
+    uint16_t moisture;
+    uint16_t temperature;
+    uint16_t humidity;
+    uint16_t battery_mv;
+    uint16_t relative_pm;
+    uint16_t heartbeat_s;
+} deadband_config_t;
+
+static deadband_config_t s_deadband = {
+    .moisture = GOPHR_DEFAULT_MOISTURE_DEADBAND,
+    .temperature = GOPHR_DEFAULT_TEMPERATURE_DEADBAND,
+    .humidity = GOPHR_DEFAULT_HUMIDITY_DEADBAND,
+    .battery_mv = GOPHR_DEFAULT_BATTERY_DEADBAND,
+    .relative_pm = GOPHR_DEFAULT_RELATIVE_DEADBAND,
+    .heartbeat_s = GOPHR_DEFAULT_REPORT_HEARTBEAT,
+};
+
+/* ---------- Subscription Resumption ---------- */
+
+/*
+ * Subscriptions are persisted (see chip_project_config.h). The server tries
+ * to resume them when it starts, which on a timer wake is before Thread has
+ * re-attached. Kick resumption again as soon as the network is back, so the
+ * controllers get the fresh readings after one CASE resumption round trip
+ * instead of waiting to re-subscribe themselves.
+ */
+static void resume_subscriptions(void)
+{
+#if CHIP_CONFIG_PERSIST_SUBSCRIPTIONS
+    if (s_subscriptions_resumed || !gophr_sleep_is_warm_wake()) return;
+    s_subscriptions_resumed = true;
+
+    CHIP_ERROR err = chip::app::InteractionModelEngine::GetInstance()->ResumeSubscriptions();
+    if (err != CHIP_NO_ERROR) {
+        ESP_LOGW(TAG, "Subscription resumption failed: %" CHIP_ERROR_FORMAT, err.Format());
+        return;
+    }
+    ESP_LOGI(TAG, "Resuming persisted subscriptions");
+#endif
+}
 
 /* ---------- Matter Event Callback ---------- */
 
@@ -32,13 +88,20 @@ static void app_event_cb(const ChipDeviceEvent *event, intptr_t arg)
     case chip::DeviceLayer::DeviceEventType::kCommissioningComplete:
         ESP_LOGI(TAG, "Commissioning complete");
         s_connected = true;
+        gophr_trace_mark(GOPHR_PHASE_JOINED);
         gophr_led_set_color(0, 76, 0); /* Green = connected */
         break;
+    case chip::DeviceLayer::DeviceEventType::kBLEDeinitialized:
+        /* CONFIG_USE_BLE_ONLY_FOR_COMMISSIONING: NimBLE and the controller are gone */
+        ESP_LOGI(TAG, "BLE released, free heap %lu bytes", (unsigned long)esp_get_free_heap_size());
+        break;
     case chip::DeviceLayer::DeviceEventType::kThreadConnectivityChange:
         if (event->ThreadConnectivityChange.Result == chip::DeviceLayer::kConnectivity_Established) {
             ESP_LOGI(TAG, "Thread network connected");
             s_connected = true;
+            gophr_trace_mark(GOPHR_PHASE_JOINED);
             gophr_led_set_color(0, 76, 0);
+            resume_subscriptions();
         } else {
             ESP_LOGW(TAG, "Thread network disconnected");
             s_connected = false;
@@ -50,8 +113,69 @@ static void app_event_cb(const ChipDeviceEvent *event, intptr_t arg)
     }
 }
 
+/* ---------- Report Config Cluster ---------- */
+
+static uint16_t *deadband_field(uint32_t attribute_id)
+{
+    switch (attribute_id) {
+    case GOPHR_ATTR_MOISTURE_DEADBAND:    return &s_deadband.moisture;
+    case GOPHR_ATTR_TEMPERATURE_DEADBAND: return &s_deadband.temperature;
+    case GOPHR_ATTR_HUMIDITY_DEADBAND:    return &s_deadband.humidity;
+    case GOPHR_ATTR_BATTERY_DEADBAND:     return &s_deadband.battery_mv;
+    case GOPHR_ATTR_RELATIVE_DEADBAND:    return &s_deadband.relative_pm;
+    case GOPHR_ATTR_REPORT_HEARTBEAT:     return &s_deadband.heartbeat_s;
+    default:                              return NULL;
+    }
+}
+
+/*
+ * Writable, non-volatile thresholds. esp_matter restores non-volatile
+ * attributes from NVS when they are created, so read them back to seed
+ * the running config.
+ */
+static esp_err_t create_report_config_cluster(node_t *node)
+{
+    endpoint_t *root = endpoint::get(node, 0);
+    cluster_t *cluster = root ? cluster::create(root, GOPHR_CLUSTER_ID_REPORT_CONFIG, CLUSTER_FLAG_SERVER) : NULL;
+    if (!cluster) return ESP_FAIL;
+
+    global::attribute::create_cluster_revision(cluster, 1);
+    global::attribute::create_feature_map(cluster, 0);
+
+    event::create(cluster, GOPHR_EVENT_SAMPLE_BACKLOG);
+
+    for (uint32_t id = GOPHR_ATTR_MOISTURE_DEADBAND; id <= GOPHR_ATTR_REPORT_HEARTBEAT; id++) {
+        uint16_t *field = deadband_field(id);
+        attribute_t *attr = attribute::create(cluster, id,
+                                              ATTRIBUTE_FLAG_WRITABLE | ATTRIBUTE_FLAG_NONVOLATILE,
+                                              esp_matter_uint16(*field));
+        if (!attr) return ESP_FAIL;
+
+        esp_matter_attr_val_t val;
+        if (attribute::get_val(attr, &val) == ESP_OK) {
+            *field = val.val.u16;
+        }
+    }
+
+    for (uint32_t id = GOPHR_ATTR_ENERGY_CYCLE; id <= GOPHR_ATTR_ENERGY_DAY; id++) {
+        if (!attribute::create(cluster, id, ATTRIBUTE_FLAG_NONE, esp_matter_uint32(0))) return ESP_FAIL;
+    }
+
+    /* The sample log keeps its own ack in NVS; this only carries the controller's writes */
+    if (!attribute::create(cluster, GOPHR_ATTR_BACKLOG_ACKED, ATTRIBUTE_FLAG_WRITABLE,
+                           esp_matter_uint32(0))) return ESP_FAIL;
+
+    ESP_LOGI(TAG, "Deadbands: moisture=%u temp=%u humidity=%u battery=%umV rel=%u/1000 heartbeat=%us",
+             s_deadband.moisture, s_deadband.temperature, s_deadband.humidity,
+             s_deadband.battery_mv, s_deadband.relative_pm, s_deadband.heartbeat_s);
+    return ESP_OK;
+}
+
 /* ---------- Attribute Update Callback ---------- */
 
+/* Written on the CHIP thread, read by the sensor task (a single aligned word) */
+static uint32_t s_backlog_acked;
+
 static esp_err_t app_attribute_update_cb(attribute::callback_type_t type,
                                           uint16_t endpoint_id,
                                           uint32_t cluster_id,
@@ -59,14 +183,61 @@ static esp_err_t app_attribute_update_cb(attribute::callback_type_t type,
                                           esp_matter_attr_val_t *val,
                                           void *priv_data)
 {
-    /* Read-only sensor device — no writable attributes from controller */
+    /* Sensor attributes are read-only; only the report config is writable */
+    if (type != attribute::PRE_UPDATE || cluster_id != GOPHR_CLUSTER_ID_REPORT_CONFIG) {
+        return ESP_OK;
+    }
+
+    if (attribute_id == GOPHR_ATTR_BACKLOG_ACKED) {
+        s_backlog_acked = val->val.u32;
+        ESP_LOGD(TAG, "Controller has the backlog up to seq %lu", (unsigned long)s_backlog_acked);
+        return ESP_OK;
+    }
+
+    uint16_t *field = deadband_field(attribute_id);
+    if (!field) return ESP_OK;
+
+    *field = val->val.u16;
+    ESP_LOGI(TAG, "Report config 0x%04lx set to %u", (unsigned long)attribute_id, *field);
     return ESP_OK;
 }
 
+/* ---------- ICD ---------- */
+
+#if CONFIG_ENABLE_ICD_SERVER
+/*
+ * Idle mode follows the sleep duration, so a controller expects the device
+ * to check in about as often as it samples. Applied at start-up; a new
+ * sleep duration takes effect on the next boot.
+ */
+static esp_err_t configure_icd(void)
+{
+    uint32_t idle_s = (uint32_t)gophr_sleep_get_duration() * 60U;
+    if (idle_s > GOPHR_ICD_MAX_IDLE_S) idle_s = GOPHR_ICD_MAX_IDLE_S;
+
+    icd::config_t icd_config;
+    icd_config.idle_mode_duration_s = idle_s;
+    icd_config.active_mode_duration_ms = GOPHR_ICD_ACTIVE_MODE_MS;
+    icd_config.slow_interval_ms = CONFIG_ICD_SLOW_POLL_INTERVAL_MS;
+    icd_config.fast_interval_ms = CONFIG_ICD_FAST_POLL_INTERVAL_MS;
+
+    ESP_LOGI(TAG, "ICD: idle %lus, active %dms, slow poll %dms", (unsigned long)idle_s,
+             GOPHR_ICD_ACTIVE_MODE_MS, CONFIG_ICD_SLOW_POLL_INTERVAL_MS);
+    return icd::set_configuration_data(&icd_config);
+}
+#endif
+
 /* ---------- Init ---------- */
 
 esp_err_t gophr_matter_init(void)
 {
+#if CONFIG_ENABLE_ICD_SERVER
+    if (configure_icd() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set ICD configuration");
+        return ESP_FAIL;
+    }
+#endif
+
     /* Create the Matter node */
     node::config_t node_config;
     node_t *node = node::create(&node_config, app_attribute_update_cb, NULL);
@@ -146,6 +317,11 @@ esp_err_t gophr_matter_init(void)
         ESP_LOGI(TAG, "Moisture %d endpoint created (ID: %d)", i + 1, s_moisture_ep_ids[i]);
     }
 
+    if (create_report_config_cluster(node) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create report config cluster");
+        return ESP_FAIL;
+    }
+
     /* Register device event callback */
     chip::DeviceLayer::PlatformMgrImpl().AddEventHandler(app_event_cb, 0);
 
@@ -155,68 +331,330 @@ esp_err_t gophr_matter_init(void)
 
 /* ---------- Attribute Updates ---------- */
 
-void gophr_matter_update_temperature(float celsius)
+/* Attributes pushed by gophr_matter_update_readings() */
+typedef enum {
+    VAL_MOISTURE_1 = 0,
+    VAL_MOISTURE_2,
+    VAL_MOISTURE_3,
+    VAL_TEMPERATURE,
+    VAL_HUMIDITY,
+    VAL_BATTERY_PERCENT,
+    VAL_BATTERY_MV,
+    VAL_COUNT,
+} matter_val_t;
+
+/* One cycle's values; kept small so the closure fits CHIP's lambda event storage */
+typedef struct {
+    uint16_t moisture[3];   /* 0.01% */
+    int16_t temperature;    /* 0.01°C */
+    uint16_t humidity;      /* 0.01% */
+    uint16_t battery_mv;
+    uint8_t battery_pct;    /* Half-percent units (200 = 100%) */
+    uint8_t mask;           /* Which values this cycle carries (bit per matter_val_t) */
+} matter_batch_t;
+
+static int32_t batch_value(const matter_batch_t *batch, int v)
 {
-    int16_t matter_temp = (int16_t)(celsius * 100.0f);
-    esp_matter_attr_val_t val = esp_matter_nullable_int16(matter_temp);
+    switch (v) {
+    case VAL_MOISTURE_1:
+    case VAL_MOISTURE_2:
+    case VAL_MOISTURE_3:      return batch->moisture[v - VAL_MOISTURE_1];
+    case VAL_TEMPERATURE:     return batch->temperature;
+    case VAL_HUMIDITY:        return batch->humidity;
+    case VAL_BATTERY_PERCENT: return batch->battery_pct;
+    case VAL_BATTERY_MV:      return batch->battery_mv;
+    default:                  return 0;
+    }
+}
 
-    chip::DeviceLayer::SystemLayer().ScheduleLambda([val]() mutable {
-        attribute::update(s_temp_ep_id,
-                          TemperatureMeasurement::Id,
-                          TemperatureMeasurement::Attributes::MeasuredValue::Id,
-                          &val);
-    });
+/* Last values written to the data model (CHIP thread only) */
+static int32_t s_applied[VAL_COUNT];
+static uint32_t s_applied_ms[VAL_COUNT];
+static uint32_t s_applied_mask = 0;
+
+static uint16_t absolute_deadband(int v)
+{
+    switch (v) {
+    case VAL_MOISTURE_1:
+    case VAL_MOISTURE_2:
+    case VAL_MOISTURE_3:  return s_deadband.moisture;
+    case VAL_TEMPERATURE: return s_deadband.temperature;
+    case VAL_HUMIDITY:    return s_deadband.humidity;
+    case VAL_BATTERY_MV:  return s_deadband.battery_mv;
+    default:              return 0;
+    }
+}
+
+/*
+ * Write when the value has left the band around the last written value, or
+ * when it differs at all and the heartbeat has run out. Measuring from the
+ * last written value (not the previous reading) gives the hysteresis: slow
+ * drift accumulates until it crosses the band, and noise around an edge
+ * does not toggle the attribute.
+ */
+static bool should_apply(int v, int32_t value, uint32_t now_ms)
+{
+    if (!(s_applied_mask & (1U << v))) return true;
+
+    int32_t last = s_applied[v];
+    if (value == last) return false;
+
+    int32_t delta = value > last ? value - last : last - value;
+    int32_t band = absolute_deadband(v);
+    int32_t rel = (int32_t)((int64_t)(last < 0 ? -last : last) * s_deadband.relative_pm / 1000);
+    if (rel > band) band = rel;
+    if (delta > band) return true;
+
+    return s_deadband.heartbeat_s &&
+           now_ms - s_applied_ms[v] >= (uint32_t)s_deadband.heartbeat_s * 1000U;
+}
+
+static void apply_value(matter_val_t v, int32_t value)
+{
+    uint16_t ep_id;
+    uint32_t cluster_id;
+    uint32_t attr_id;
+    esp_matter_attr_val_t val;
+
+    switch (v) {
+    case VAL_MOISTURE_1:
+    case VAL_MOISTURE_2:
+    case VAL_MOISTURE_3:
+        ep_id = s_moisture_ep_ids[v - VAL_MOISTURE_1];
+        cluster_id = RelativeHumidityMeasurement::Id;
+        attr_id = RelativeHumidityMeasurement::Attributes::MeasuredValue::Id;
+        val = esp_matter_nullable_uint16((uint16_t)value);
+        break;
+    case VAL_TEMPERATURE:
+        ep_id = s_temp_ep_id;
+        cluster_id = TemperatureMeasurement::Id;
+        attr_id = TemperatureMeasurement::Attributes::MeasuredValue::Id;
+        val = esp_matter_nullable_int16((int16_t)value);
+        break;
+    case VAL_HUMIDITY:
+        ep_id = s_humidity_ep_id;
+        cluster_id = RelativeHumidityMeasurement::Id;
+        attr_id = RelativeHumidityMeasurement::Attributes::MeasuredValue::Id;
+        val = esp_matter_nullable_uint16((uint16_t)value);
+        break;
+    case VAL_BATTERY_PERCENT:
+        ep_id = s_temp_ep_id;
+        cluster_id = PowerSource::Id;
+        attr_id = PowerSource::Attributes::BatPercentRemaining::Id;
+        val = esp_matter_nullable_uint8((uint8_t)value);
+        break;
+    case VAL_BATTERY_MV:
+        ep_id = s_temp_ep_id;
+        cluster_id = PowerSource::Id;
+        attr_id = PowerSource::Attributes::BatVoltage::Id;
+        val = esp_matter_nullable_uint32((uint32_t)value);
+        break;
+    default:
+        return;
+    }
+    attribute::update(ep_id, cluster_id, attr_id, &val);
 }
 
-void gophr_matter_update_humidity(float percent)
+void gophr_matter_update_readings(const sensor_readings_t *readings, uint32_t fields)
 {
-    uint16_t matter_hum = (uint16_t)(percent * 100.0f);
-    esp_matter_attr_val_t val = esp_matter_nullable_uint16(matter_hum);
+    matter_batch_t batch = {};
 
-    chip::DeviceLayer::SystemLayer().ScheduleLambda([val]() mutable {
-        attribute::update(s_humidity_ep_id,
-                          RelativeHumidityMeasurement::Id,
-                          RelativeHumidityMeasurement::Attributes::MeasuredValue::Id,
-                          &val);
+    if (fields & GOPHR_MATTER_UPDATE_MOISTURE) {
+        for (int i = 0; i < 3; i++) {
+            batch.moisture[i] = (uint16_t)(readings->moisture_percent[i] * 100.0f);
+        }
+        batch.mask |= (1U << VAL_MOISTURE_1) | (1U << VAL_MOISTURE_2) | (1U << VAL_MOISTURE_3);
+    }
+    if (fields & GOPHR_MATTER_UPDATE_CLIMATE) {
+        batch.temperature = (int16_t)(readings->temperature * 100.0f);
+        batch.humidity = (uint16_t)(readings->humidity * 100.0f);
+        batch.mask |= (1U << VAL_TEMPERATURE) | (1U << VAL_HUMIDITY);
+    }
+    if (fields & GOPHR_MATTER_UPDATE_BATTERY) {
+        batch.battery_pct = (uint8_t)(readings->battery_percent * 2.0f);
+        batch.battery_mv = (uint16_t)(readings->battery_voltage * 1000.0f);
+        batch.mask |= (1U << VAL_BATTERY_PERCENT) | (1U << VAL_BATTERY_MV);
+    }
+    if (!batch.mask) return;
+
+    /* One closure per cycle: every changed attribute lands in the same report run */
+    chip::DeviceLayer::SystemLayer().ScheduleLambda([batch]() {
+        uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        int changed = 0;
+
+        /* Battery percent is coarse and derived from the voltage; move it with the voltage */
+        bool battery = (batch.mask & (1U << VAL_BATTERY_MV)) &&
+                       should_apply(VAL_BATTERY_MV, batch.battery_mv, now_ms);
+
+        for (int v = 0; v < VAL_COUNT; v++) {
+            uint32_t bit = 1U << v;
+            if (!(batch.mask & bit)) continue;
+            int32_t value = batch_value(&batch, v);
+
+            bool apply;
+            if (v == VAL_BATTERY_PERCENT || v == VAL_BATTERY_MV) {
+                apply = battery || !(s_applied_mask & bit);
+            } else {
+                apply = should_apply(v, value, now_ms);
+            }
+            if (!apply) continue;
+
+            apply_value((matter_val_t)v, value);
+            s_applied[v] = value;
+            s_applied_ms[v] = now_ms;
+            s_applied_mask |= bit;
+            changed++;
+        }
+        if (changed && s_connected) {
+            gophr_trace_mark(GOPHR_PHASE_REPORT);
+        }
+        ESP_LOGD(TAG, "Applied %d attribute(s) outside their deadband", changed);
     });
 }
 
-void gophr_matter_update_moisture(int sensor_index, float percent)
+/* ---------- Report Flush ---------- */
+
+#define MOISTURE_VALS   ((1U << VAL_MOISTURE_1) | (1U << VAL_MOISTURE_2) | (1U << VAL_MOISTURE_3))
+
+/* Result of the last check (sensor task waits for it; the closure captures nothing) */
+static bool s_flush_settled;
+static uint16_t s_flush_moisture[3];
+static TaskHandle_t s_flush_task;
+
+/*
+ * Every subscription has been sent the current data model and has acked
+ * it: nothing dirty, no report run pending and no report waiting for its
+ * status response. CHIP thread only.
+ */
+static bool reports_settled(void)
+{
+    chip::app::InteractionModelEngine *im = chip::app::InteractionModelEngine::GetInstance();
+    chip::app::reporting::Engine &engine = im->GetReportingEngine();
+    return s_connected && (s_applied_mask & MOISTURE_VALS) == MOISTURE_VALS &&
+           im->GetNumActiveReadHandlers(chip::app::ReadHandler::InteractionType::Subscribe) > 0 &&
+           im->GetNumDirtySubscriptions() == 0 && !engine.IsRunScheduled() &&
+           engine.GetNumReportsInFlight() == 0;
+}
+
+esp_err_t gophr_matter_flush_reports(uint32_t timeout_ms, uint16_t moisture[3])
 {
-    if (sensor_index < 0 || sensor_index >= 3) return;
+    uint32_t start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    s_flush_task = xTaskGetCurrentTaskHandle();
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, 0); /* Drop a late wakeup from a timed-out check */
+
+        /* Queued behind the pending update closures, so it sees their writes */
+        chip::DeviceLayer::SystemLayer().ScheduleLambda([]() {
+            s_flush_settled = reports_settled();
+            for (int i = 0; i < 3; i++) {
+                s_flush_moisture[i] = (uint16_t)s_applied[VAL_MOISTURE_1 + i];
+            }
+            xTaskNotifyGive(s_flush_task);
+        });
+        if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(GOPHR_MATTER_BACKLOG_TIMEOUT_MS))) {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        if (s_flush_settled) {
+            if (moisture) memcpy(moisture, s_flush_moisture, sizeof(s_flush_moisture));
+            ESP_LOGD(TAG, "Reports acked by subscribers in %lums", (unsigned long)(now_ms - start_ms));
+            return ESP_OK;
+        }
+        if (now_ms - start_ms >= timeout_ms) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(pdMS_TO_TICKS(GOPHR_MATTER_FLUSH_POLL_MS));
+    }
+}
 
-    uint16_t matter_hum = (uint16_t)(percent * 100.0f);
-    uint16_t ep_id = s_moisture_ep_ids[sensor_index];
-    esp_matter_attr_val_t val = esp_matter_nullable_uint16(matter_hum);
+/* ---------- Energy Ledger ---------- */
 
-    chip::DeviceLayer::SystemLayer().ScheduleLambda([ep_id, val]() mutable {
-        attribute::update(ep_id,
-                          RelativeHumidityMeasurement::Id,
-                          RelativeHumidityMeasurement::Attributes::MeasuredValue::Id,
-                          &val);
+void gophr_matter_update_energy(const gophr_energy_summary_t *energy)
+{
+    const uint32_t values[3] = {energy->cycle_uah, energy->today_uah, energy->day_uah};
+
+    chip::DeviceLayer::SystemLayer().ScheduleLambda([v0 = values[0], v1 = values[1], v2 = values[2]]() {
+        static uint32_t s_energy_written[3];
+        static bool s_energy_valid = false;
+        const uint32_t vals[3] = {v0, v1, v2};
+
+        for (int i = 0; i < 3; i++) {
+            if (s_energy_valid && s_energy_written[i] == vals[i]) continue;
+            esp_matter_attr_val_t val = esp_matter_uint32(vals[i]);
+            attribute::update(0, GOPHR_CLUSTER_ID_REPORT_CONFIG, GOPHR_ATTR_ENERGY_CYCLE + i, &val);
+            s_energy_written[i] = vals[i];
+        }
+        s_energy_valid = true;
     });
 }
 
-void gophr_matter_update_battery(float voltage, float percent)
+/* ---------- Sample Backlog ---------- */
+
+/* SampleBacklog event body: a struct with the packed samples as field 0 */
+class SampleBacklogEvent : public chip::app::EventLoggingDelegate
 {
-    /* Battery percentage in half-percent units (200 = 100%) */
-    uint8_t bat_pct = (uint8_t)(percent * 2.0f);
-    /* Battery voltage in millivolts */
-    uint32_t bat_mv = (uint32_t)(voltage * 1000.0f);
+public:
+    explicit SampleBacklogEvent(chip::ByteSpan data) : mData(data) {}
+
+    CHIP_ERROR WriteEvent(chip::TLV::TLVWriter &writer) override
+    {
+        chip::TLV::TLVType outer;
+        ReturnErrorOnFailure(writer.StartContainer(
+            chip::TLV::ContextTag(chip::to_underlying(chip::app::EventDataIB::Tag::kData)),
+            chip::TLV::kTLVType_Structure, outer));
+        ReturnErrorOnFailure(writer.Put(chip::TLV::ContextTag(0), mData));
+        return writer.EndContainer(outer);
+    }
+
+private:
+    chip::ByteSpan mData;
+};
+
+#define BACKLOG_PAYLOAD_MAX (GOPHR_BACKLOG_HEADER_LEN + GOPHR_MATTER_BACKLOG_PER_EVENT * GOPHR_SAMPLE_PACKED_LEN)
 
-    esp_matter_attr_val_t pct_val = esp_matter_nullable_uint8(bat_pct);
-    esp_matter_attr_val_t mv_val = esp_matter_nullable_uint32(bat_mv);
+/* One event in flight at a time (sensor task); the closure captures nothing */
+static uint8_t s_backlog_payload[BACKLOG_PAYLOAD_MAX];
+static size_t s_backlog_len;
+static TaskHandle_t s_backlog_task;
 
-    chip::DeviceLayer::SystemLayer().ScheduleLambda([pct_val, mv_val]() mutable {
-        attribute::update(s_temp_ep_id,
-                          PowerSource::Id,
-                          PowerSource::Attributes::BatPercentRemaining::Id,
-                          &pct_val);
-        attribute::update(s_temp_ep_id,
-                          PowerSource::Id,
-                          PowerSource::Attributes::BatVoltage::Id,
-                          &mv_val);
+esp_err_t gophr_matter_send_backlog(const gophr_sample_t *samples, int count)
+{
+    if (count > GOPHR_MATTER_BACKLOG_PER_EVENT) count = GOPHR_MATTER_BACKLOG_PER_EVENT;
+    s_backlog_len = gophr_samplelog_pack(s_backlog_payload, sizeof(s_backlog_payload),
+                                         (uint32_t)time(NULL), samples, count);
+    if (!s_backlog_len) return ESP_ERR_INVALID_ARG;
+
+    static CHIP_ERROR s_result;
+    s_backlog_task = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0); /* Drop a late wakeup from a timed-out event */
+
+    chip::DeviceLayer::SystemLayer().ScheduleLambda([]() {
+        SampleBacklogEvent event(chip::ByteSpan(s_backlog_payload, s_backlog_len));
+        chip::app::EventOptions options;
+        options.mPath = chip::app::ConcreteEventPath(0, GOPHR_CLUSTER_ID_REPORT_CONFIG,
+                                                     GOPHR_EVENT_SAMPLE_BACKLOG);
+        options.mPriority = chip::app::PriorityLevel::Info;
+
+        chip::EventNumber number;
+        s_result = chip::app::EventManagement::GetInstance().LogEvent(&event, options, number);
+        xTaskNotifyGive(s_backlog_task);
     });
+
+    if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(GOPHR_MATTER_BACKLOG_TIMEOUT_MS))) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (s_result != CHIP_NO_ERROR) {
+        ESP_LOGW(TAG, "Backlog event failed: %" CHIP_ERROR_FORMAT, s_result.Format());
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+uint32_t gophr_matter_backlog_acked(void)
+{
+    return s_backlog_acked;
 }
 
 bool gophr_matter_is_connected(void)
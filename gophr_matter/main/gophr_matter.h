@@ -1,6 +1,9 @@
 #pragma once
 
 #include "esp_err.h"
+#include "gophr_sensors.h"
+#include "gophr_samplelog.h"
+#include "gophr_energy.h"
 #include <stdbool.h>
 
 #ifdef __cplusplus
@@ -14,22 +17,100 @@ extern "C" {
 #define GOPHR_VENDOR_NAME       "GOPHR"
 #define GOPHR_PRODUCT_NAME      "Gophr-C6"
 
+/* ---------- ICD (sleepy Thread) ---------- */
+#define GOPHR_ICD_ACTIVE_MODE_MS    1000    /* Fast polling after each report or request */
+#define GOPHR_ICD_MAX_IDLE_S        64800   /* Spec limit for the idle mode interval (18h) */
+
+/* ---------- Report Deadbands ---------- */
+/*
+ * Matter has no reportable-change setting, so the device filters instead:
+ * an attribute is only written when the reading leaves the band around the
+ * last written value. The band is the larger of the absolute and relative
+ * thresholds. Readings that stay inside the band are written anyway after
+ * the heartbeat interval. All thresholds are writable (and kept in NVS)
+ * through a manufacturer-specific cluster on endpoint 0.
+ *
+ * Moisture readings come in 5% steps (gophr_sensors.c), so any moisture
+ * band below 500 filters nothing. The default of one step drops a reading
+ * flickering across a rounding boundary; a single step still goes out with
+ * the heartbeat.
+ */
+#define GOPHR_CLUSTER_ID_REPORT_CONFIG      0xFFF1FC00  /* Test vendor 0xFFF1, cluster 0xFC00 */
+
+#define GOPHR_ATTR_MOISTURE_DEADBAND        0x0000  /* u16, 0.01%; readings move in 5% steps */
+#define GOPHR_ATTR_TEMPERATURE_DEADBAND     0x0001  /* u16, 0.01°C */
+#define GOPHR_ATTR_HUMIDITY_DEADBAND        0x0002  /* u16, 0.01% */
+#define GOPHR_ATTR_BATTERY_DEADBAND         0x0003  /* u16, mV (battery % follows voltage) */
+#define GOPHR_ATTR_RELATIVE_DEADBAND        0x0004  /* u16, per mille of last value, 0 = off */
+#define GOPHR_ATTR_REPORT_HEARTBEAT         0x0005  /* u16, seconds, 0 = off */
+
+#define GOPHR_DEFAULT_MOISTURE_DEADBAND     500     /* 5%: one step, see below */
+#define GOPHR_DEFAULT_TEMPERATURE_DEADBAND  20      /* 0.2°C */
+#define GOPHR_DEFAULT_HUMIDITY_DEADBAND     100     /* 1% */
+#define GOPHR_DEFAULT_BATTERY_DEADBAND      20      /* 20mV */
+#define GOPHR_DEFAULT_RELATIVE_DEADBAND     0
+#define GOPHR_DEFAULT_REPORT_HEARTBEAT      3600    /* 1h */
+
+/* ---------- Energy Ledger ---------- */
+/* Read-only diagnostics on the same cluster (gophr_energy.h) */
+#define GOPHR_ATTR_ENERGY_CYCLE             0x0010  /* u32, uAh of the last wake cycle */
+#define GOPHR_ATTR_ENERGY_TODAY             0x0011  /* u32, uAh so far in the current 24h */
+#define GOPHR_ATTR_ENERGY_DAY               0x0012  /* u32, uAh of the last complete 24h */
+
+/* ---------- Sample Backlog ---------- */
+/* Samples logged while disconnected go out as events on the same cluster */
+#define GOPHR_EVENT_SAMPLE_BACKLOG          0x00    /* Field 0: octet string, gophr_samplelog_pack format */
+#define GOPHR_ATTR_BACKLOG_ACKED            0x0020  /* u32, written by the controller: last seq it stored */
+#define GOPHR_MATTER_BACKLOG_PER_EVENT      3
+#define GOPHR_MATTER_BACKLOG_TIMEOUT_MS     1000    /* Wait for the CHIP thread to log the event */
+
+/* ---------- Report Flush ---------- */
+#define GOPHR_MATTER_FLUSH_TIMEOUT_MS   5000    /* Budget before sleeping anyway */
+#define GOPHR_MATTER_FLUSH_POLL_MS      50
+
 /* ---------- API ---------- */
 
-/* Create the Matter node with all endpoints */
+/* Create the Matter node with all endpoints (ICD intervals from the sleep config) */
 esp_err_t gophr_matter_init(void);
 
-/* Update temperature attribute (Celsius) */
-void gophr_matter_update_temperature(float celsius);
+/* Which parts of a reading snapshot to push */
+#define GOPHR_MATTER_UPDATE_MOISTURE    (1U << 0)
+#define GOPHR_MATTER_UPDATE_CLIMATE     (1U << 1)   /* AHT20 temperature + humidity */
+#define GOPHR_MATTER_UPDATE_BATTERY     (1U << 2)
+#define GOPHR_MATTER_UPDATE_ALL         0x7U
+
+/*
+ * Push the selected readings to the data model in one scheduled update.
+ * Values are quantized to the cluster units and only attributes that left
+ * their deadband (or hit the heartbeat) are written, so subscribers get at
+ * most one report per cycle.
+ */
+void gophr_matter_update_readings(const sensor_readings_t *readings, uint32_t fields);
+
+/* Publish the energy ledger summary (written only when it changed) */
+void gophr_matter_update_energy(const gophr_energy_summary_t *energy);
 
-/* Update AHT20 humidity attribute (%) */
-void gophr_matter_update_humidity(float percent);
+/*
+ * Block until every subscription has been sent the updates pushed so far
+ * and acknowledged them (nothing dirty, no report waiting for its status
+ * response), polling for up to `timeout_ms` (0 = check once). Returns
+ * ESP_ERR_TIMEOUT if not, including when nobody is subscribed. On ESP_OK,
+ * `moisture` (may be NULL) gets the moisture the subscribers now hold, in
+ * 0.01%.
+ */
+esp_err_t gophr_matter_flush_reports(uint32_t timeout_ms, uint16_t moisture[3]);
 
-/* Update soil moisture attribute (%) for sensor 0-2 */
-void gophr_matter_update_moisture(int sensor_index, float percent);
+/*
+ * Log up to GOPHR_MATTER_BACKLOG_PER_EVENT samples as one SampleBacklog
+ * event. Blocks until the event is in the stack's event buffer, from where
+ * it is delivered to subscribers in order. Being in the buffer says nothing
+ * about a subscriber having read it (the ring overwrites Info events), so
+ * the samples stay in the log until the controller writes BacklogAcked.
+ */
+esp_err_t gophr_matter_send_backlog(const gophr_sample_t *samples, int count);
 
-/* Update battery attributes */
-void gophr_matter_update_battery(float voltage, float percent);
+/* Last seq the controller confirmed through BacklogAcked (0 = none yet) */
+uint32_t gophr_matter_backlog_acked(void);
 
 /* Check if device is commissioned and on the network */
 bool gophr_matter_is_connected(void);
@@ -0,0 +1,130 @@
+#include "gophr_sched.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "gophr_sched";
+
+static const gophr_job_cfg_t s_default_jobs[GOPHR_JOB_COUNT] = {
+    [GOPHR_JOB_MOISTURE] = { GOPHR_SCHED_MOISTURE_PERIOD_MS, GOPHR_SCHED_MOISTURE_JITTER_MS, GOPHR_RAIL_SENSOR },
+    [GOPHR_JOB_AHT20]    = { GOPHR_SCHED_AHT20_PERIOD_MS, GOPHR_SCHED_AHT20_JITTER_MS, GOPHR_RAIL_AHT20 },
+    [GOPHR_JOB_POWER]    = { GOPHR_SCHED_POWER_PERIOD_MS, GOPHR_SCHED_POWER_JITTER_MS, GOPHR_RAIL_SENSOR },
+    [GOPHR_JOB_SLEEP]    = { GOPHR_SCHED_SLEEP_PERIOD_MS, GOPHR_SCHED_SLEEP_JITTER_MS, 0 },
+};
+
+static gophr_job_cfg_t s_jobs[GOPHR_JOB_COUNT];
+static int64_t s_deadline_us[GOPHR_JOB_COUNT];
+static esp_timer_handle_t s_timer;
+static TaskHandle_t s_waiter;
+
+static void timer_cb(void *arg)
+{
+    if (s_waiter) xTaskNotifyGive(s_waiter);
+}
+
+esp_err_t gophr_sched_init(const gophr_job_cfg_t *jobs)
+{
+    if (!jobs) jobs = s_default_jobs;
+
+    const esp_timer_create_args_t args = {
+        .callback = timer_cb,
+        .name = "gophr_sched",
+    };
+    esp_err_t ret = esp_timer_create(&args, &s_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Timer create failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < GOPHR_JOB_COUNT; i++) {
+        s_jobs[i] = jobs[i];
+        s_deadline_us[i] = now;
+    }
+    return ESP_OK;
+}
+
+/* Jobs that may run at `now` without any of them running early */
+static uint32_t due_jobs(int64_t now)
+{
+    uint32_t due = 0;
+    for (int i = 0; i < GOPHR_JOB_COUNT; i++) {
+        if (s_deadline_us[i] <= now) due |= GOPHR_JOB_BIT(i);
+    }
+    return due;
+}
+
+/*
+ * Start of the next window. No job may run past deadline + jitter, so the
+ * window opens no later than the earliest such limit; within that, it opens
+ * at the last deadline that still fits, so every job due by then shares it.
+ */
+static int64_t window_start(void)
+{
+    int64_t limit = INT64_MAX;
+    int64_t first = INT64_MAX;
+    for (int i = 0; i < GOPHR_JOB_COUNT; i++) {
+        int64_t latest = s_deadline_us[i] + (int64_t)s_jobs[i].jitter_ms * 1000;
+        if (latest < limit) limit = latest;
+        if (s_deadline_us[i] < first) first = s_deadline_us[i];
+    }
+
+    int64_t start = first;
+    for (int i = 0; i < GOPHR_JOB_COUNT; i++) {
+        if (s_deadline_us[i] <= limit && s_deadline_us[i] > start) start = s_deadline_us[i];
+    }
+    return start;
+}
+
+uint32_t gophr_sched_wait(void)
+{
+    s_waiter = xTaskGetCurrentTaskHandle();
+
+    int64_t now = esp_timer_get_time();
+    int64_t start = window_start();
+    if (start > now) {
+        esp_timer_stop(s_timer);
+        ulTaskNotifyTake(pdTRUE, 0); /* Drop a stale wakeup */
+        esp_timer_start_once(s_timer, (uint64_t)(start - now));
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        now = esp_timer_get_time();
+    }
+
+    /* Everything already past its deadline shares this window */
+    uint32_t due = due_jobs(now);
+    for (int i = 0; i < GOPHR_JOB_COUNT; i++) {
+        if (!(due & GOPHR_JOB_BIT(i))) continue;
+
+        /* Keep the cadence; after a long stall (e.g. light sleep) restart from now */
+        int64_t period_us = (int64_t)s_jobs[i].period_ms * 1000;
+        s_deadline_us[i] += period_us;
+        if (s_deadline_us[i] <= now) s_deadline_us[i] = now + period_us;
+    }
+
+    ESP_LOGD(TAG, "Window: jobs 0x%02lx, rails 0x%02lx",
+             (unsigned long)due, (unsigned long)gophr_sched_rails(due));
+    return due;
+}
+
+uint32_t gophr_sched_rails(uint32_t jobs)
+{
+    uint32_t rails = 0;
+    for (int i = 0; i < GOPHR_JOB_COUNT; i++) {
+        if (jobs & GOPHR_JOB_BIT(i)) rails |= s_jobs[i].rails;
+    }
+    return rails;
+}
+
+uint32_t gophr_sched_idle_rails(void)
+{
+    int64_t hold_until = esp_timer_get_time() + (int64_t)GOPHR_SCHED_RAIL_HOLD_MS * 1000;
+    uint32_t used = 0, busy = 0;
+    for (int i = 0; i < GOPHR_JOB_COUNT; i++) {
+        used |= s_jobs[i].rails;
+        if (s_deadline_us[i] <= hold_until) busy |= s_jobs[i].rails;
+    }
+    return used & ~busy;
+}
@@ -1,77 +1,124 @@
 #include "gophr_sensors.h"
 #include "gophr_drivers.h"
+#include "gophr_filter.h"
+#include "gophr_settle.h"
+#include "gophr_sleep.h"
+#include "gophr_persist.h"
+#include "gophr_seqlock.h"
 
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include <string.h>
+#include <stddef.h>
 #include <math.h>
-#include <stdlib.h>
 
 static const char *TAG = "gophr_sensors";
 
-static moisture_cal_t s_calibration[MOISTURE_SENSOR_COUNT];
-static sensor_readings_t s_readings;
+/* Kept in RTC memory so a warm wake can skip NVS and start from the last values */
+#define SENSORS_RTC_MAGIC   0x47434C31  /* "GCL1" */
+static RTC_DATA_ATTR uint32_t s_rtc_magic;
+static RTC_DATA_ATTR moisture_cal_t s_calibration[MOISTURE_SENSOR_COUNT];
+static RTC_DATA_ATTR uint32_t s_rtc_cal_crc;   /* Guards the RTC copy against brownout corruption */
+static RTC_DATA_ATTR sensor_readings_t s_readings;
+
+static const float s_factory_cal[MOISTURE_SENSOR_COUNT][2] = {
+    {FACTORY_S1_DRY, FACTORY_S1_WET},
+    {FACTORY_S2_DRY, FACTORY_S2_WET},
+    {FACTORY_S3_DRY, FACTORY_S3_WET},
+};
+
+/*
+ * Published copies of s_readings for readers on other tasks (Zigbee/Matter),
+ * behind a latched seqlock so a reader never waits on the (lower priority)
+ * sensor task.
+ */
+static sensor_readings_t s_published[2];
+static gophr_seqlock_t s_published_lock;
+
+/* Filter chain state and configuration for each moisture sensor */
+static gophr_filter_t s_moisture_filter[MOISTURE_SENSOR_COUNT];
+static const gophr_filter_cfg_t s_moisture_filter_cfg[MOISTURE_SENSOR_COUNT] = {
+    GOPHR_FILTER_CFG_MOISTURE_DEFAULT(),
+    GOPHR_FILTER_CFG_MOISTURE_DEFAULT(),
+    GOPHR_FILTER_CFG_MOISTURE_DEFAULT(),
+};
 
-/* Median filter buffers */
-static float s_moisture_buf[MOISTURE_SENSOR_COUNT][MEDIAN_FILTER_WINDOW];
-static int s_moisture_buf_idx[MOISTURE_SENSOR_COUNT];
-static int s_moisture_buf_count[MOISTURE_SENSOR_COUNT];
+/* Settling thresholds for each moisture sensor */
+static const gophr_settle_cfg_t s_moisture_settle_cfg[MOISTURE_SENSOR_COUNT] = {
+    GOPHR_SETTLE_CFG_DEFAULT(),
+    GOPHR_SETTLE_CFG_DEFAULT(),
+    GOPHR_SETTLE_CFG_DEFAULT(),
+};
 
 /* GPIO pin for each moisture sensor */
 static const int s_moisture_gpio[MOISTURE_SENSOR_COUNT] = {
     GPIO_MOISTURE_1, GPIO_MOISTURE_2, GPIO_MOISTURE_3
 };
 
-/* ---------- Median Filter ---------- */
+/* ---------- Calibration NVS ---------- */
 
-static int float_compare(const void *a, const void *b)
+/*
+ * All calibration lives in one versioned blob, so a load is one lookup and
+ * a save replaces every sensor atomically. Bump CAL_BLOB_VERSION (and
+ * convert in load) if moisture_cal_t changes.
+ */
+#define CAL_NAMESPACE       "gophr_cal"
+#define CAL_BLOB_KEY        "cal"
+#define CAL_BLOB_VERSION    1
+
+typedef struct {
+    uint16_t version;
+    uint16_t count;         /* MOISTURE_SENSOR_COUNT */
+    moisture_cal_t sensors[MOISTURE_SENSOR_COUNT];
+    uint32_t crc;           /* CRC32 of everything above */
+} cal_blob_t;
+
+static uint32_t cal_blob_crc(const cal_blob_t *blob)
 {
-    float fa = *(const float *)a;
-    float fb = *(const float *)b;
-    if (fa < fb) return -1;
-    if (fa > fb) return 1;
-    return 0;
+    return esp_rom_crc32_le(0, (const uint8_t *)blob, offsetof(cal_blob_t, crc));
 }
 
-static float median_filter(float *buf, int count)
+static uint32_t rtc_cal_crc(void)
 {
-    if (count == 0) return NAN;
-
-    float sorted[MEDIAN_FILTER_WINDOW];
-    memcpy(sorted, buf, count * sizeof(float));
-    qsort(sorted, count, sizeof(float), float_compare);
-
-    return sorted[count / 2];
+    return esp_rom_crc32_le(0, (const uint8_t *)s_calibration, sizeof(s_calibration));
 }
 
-/* ---------- Calibration NVS ---------- */
-
-esp_err_t gophr_sensors_load_calibration(void)
+static bool load_cal_blob(nvs_handle_t nvs)
 {
-    nvs_handle_t nvs;
-    esp_err_t ret = nvs_open("gophr_cal", NVS_READONLY, &nvs);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "No calibration in NVS, using factory defaults");
-        gophr_sensors_factory_reset_calibration();
-        return ESP_OK;
+    cal_blob_t blob;
+    size_t sz = sizeof(blob);
+    if (nvs_get_blob(nvs, CAL_BLOB_KEY, &blob, &sz) != ESP_OK) return false;
+
+    if (sz != sizeof(blob) || blob.version != CAL_BLOB_VERSION ||
+        blob.count != MOISTURE_SENSOR_COUNT || blob.crc != cal_blob_crc(&blob)) {
+        ESP_LOGW(TAG, "Calibration blob invalid (size %u, version %u)", (unsigned)sz, blob.version);
+        return false;
     }
+    memcpy(s_calibration, blob.sensors, sizeof(s_calibration));
+    return true;
+}
+
+/* Calibration from before the blob: four keys per sensor. Returns false if there is none. */
+static bool load_legacy_calibration(nvs_handle_t nvs)
+{
+    bool found = false;
 
     for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
         char key[16];
 
         snprintf(key, sizeof(key), "s%d_dry", i);
         size_t sz = sizeof(float);
-        if (nvs_get_blob(nvs, key, &s_calibration[i].dry_value, &sz) != ESP_OK) {
-            ESP_LOGW(TAG, "Missing cal key %s", key);
-        }
+        if (nvs_get_blob(nvs, key, &s_calibration[i].dry_value, &sz) == ESP_OK) found = true;
 
         snprintf(key, sizeof(key), "s%d_wet", i);
         sz = sizeof(float);
-        if (nvs_get_blob(nvs, key, &s_calibration[i].wet_value, &sz) != ESP_OK) {
-            ESP_LOGW(TAG, "Missing cal key %s", key);
-        }
+        if (nvs_get_blob(nvs, key, &s_calibration[i].wet_value, &sz) == ESP_OK) found = true;
 
         snprintf(key, sizeof(key), "s%d_dts", i);
         sz = sizeof(s_calibration[i].dry_timestamp);
@@ -84,82 +131,187 @@ esp_err_t gophr_sensors_load_calibration(void)
         if (nvs_get_str(nvs, key, s_calibration[i].wet_timestamp, &sz) != ESP_OK) {
             strcpy(s_calibration[i].wet_timestamp, "Factory");
         }
-
-        ESP_LOGI(TAG, "Sensor %d cal: dry=%.3fV (%s), wet=%.3fV (%s)",
-                 i + 1, s_calibration[i].dry_value, s_calibration[i].dry_timestamp,
-                 s_calibration[i].wet_value, s_calibration[i].wet_timestamp);
     }
-
-    nvs_close(nvs);
-    return ESP_OK;
+    return found;
 }
 
-esp_err_t gophr_sensors_save_calibration(void)
+static int s_cal_record = -1;
+static bool s_cal_legacy;       /* Legacy keys still present, erase them with the next save */
+
+static void write_calibration(gophr_persist_writer_t *w)
 {
-    nvs_handle_t nvs;
-    ESP_RETURN_ON_ERROR(nvs_open("gophr_cal", NVS_READWRITE, &nvs), TAG, "NVS open failed");
+    cal_blob_t blob = {
+        .version = CAL_BLOB_VERSION,
+        .count = MOISTURE_SENSOR_COUNT,
+    };
+    memcpy(blob.sensors, s_calibration, sizeof(blob.sensors));
+    blob.crc = cal_blob_crc(&blob);
+    gophr_persist_put_blob(w, CAL_BLOB_KEY, &blob, sizeof(blob));
+
+    if (s_cal_legacy && w->err == ESP_OK) {
+        static const char *const suffixes[] = {"dry", "wet", "dts", "wts"};
+        for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
+            for (int k = 0; k < 4; k++) {
+                char key[16];
+                snprintf(key, sizeof(key), "s%d_%s", i, suffixes[k]);
+                gophr_persist_erase(w, key);
+            }
+        }
+        s_cal_legacy = (w->err != ESP_OK);
+    }
+}
 
+esp_err_t gophr_sensors_load_calibration(void)
+{
+    /* Start from the factory values so a partial legacy set is still complete */
     for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
-        char key[16];
+        s_calibration[i].dry_value = s_factory_cal[i][0];
+        s_calibration[i].wet_value = s_factory_cal[i][1];
+    }
 
-        snprintf(key, sizeof(key), "s%d_dry", i);
-        nvs_set_blob(nvs, key, &s_calibration[i].dry_value, sizeof(float));
+    nvs_handle_t nvs;
+    bool loaded = false;
+    bool migrate = false;
+    if (nvs_open(CAL_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        loaded = load_cal_blob(nvs);
+        if (!loaded) {
+            loaded = migrate = load_legacy_calibration(nvs);
+        }
+        nvs_close(nvs);
+    }
 
-        snprintf(key, sizeof(key), "s%d_wet", i);
-        nvs_set_blob(nvs, key, &s_calibration[i].wet_value, sizeof(float));
+    if (!loaded) {
+        ESP_LOGW(TAG, "No calibration in NVS, using factory defaults");
+        gophr_sensors_factory_reset_calibration();
+        return ESP_OK;
+    }
 
-        snprintf(key, sizeof(key), "s%d_dts", i);
-        nvs_set_str(nvs, key, s_calibration[i].dry_timestamp);
+    if (migrate) {
+        ESP_LOGI(TAG, "Migrating calibration to a single blob");
+        s_cal_legacy = true;
+        gophr_sensors_save_calibration();
+    }
 
-        snprintf(key, sizeof(key), "s%d_wts", i);
-        nvs_set_str(nvs, key, s_calibration[i].wet_timestamp);
+    for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
+        ESP_LOGI(TAG, "Sensor %d cal: dry=%.3fV (%s), wet=%.3fV (%s)",
+                 i + 1, s_calibration[i].dry_value, s_calibration[i].dry_timestamp,
+                 s_calibration[i].wet_value, s_calibration[i].wet_timestamp);
     }
+    s_rtc_cal_crc = rtc_cal_crc();
+    return ESP_OK;
+}
 
-    nvs_commit(nvs);
-    nvs_close(nvs);
-    ESP_LOGI(TAG, "Calibration saved to NVS");
+esp_err_t gophr_sensors_save_calibration(void)
+{
+    /* RTC copy is current right away; NVS follows with the next persist flush */
+    s_rtc_cal_crc = rtc_cal_crc();
+    gophr_persist_mark_dirty(s_cal_record);
     return ESP_OK;
 }
 
+/* ---------- Reading Snapshots ---------- */
+
+static void publish_readings(void)
+{
+    gophr_seqlock_write(&s_published_lock, s_published, &s_readings, sizeof(s_readings));
+}
+
+void gophr_sensors_get_readings(sensor_readings_t *out)
+{
+    gophr_seqlock_read(&s_published_lock, s_published, out, sizeof(*out));
+}
+
 /* ---------- Init ---------- */
 
 esp_err_t gophr_sensors_init(void)
 {
+    for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
+        gophr_filter_reset(&s_moisture_filter[i]);
+    }
+    s_cal_record = gophr_persist_register(CAL_NAMESPACE, write_calibration);
+
+    /* Warm wake: calibration and last readings survived in RTC memory */
+    if (gophr_sleep_is_warm_wake() && s_rtc_magic == SENSORS_RTC_MAGIC &&
+        s_rtc_cal_crc == rtc_cal_crc()) {
+        publish_readings();
+        ESP_LOGI(TAG, "Sensor subsystem initialized (warm, calibration from RTC)");
+        return ESP_OK;
+    }
+
     memset(&s_readings, 0, sizeof(s_readings));
-    memset(s_moisture_buf, 0, sizeof(s_moisture_buf));
-    memset(s_moisture_buf_idx, 0, sizeof(s_moisture_buf_idx));
-    memset(s_moisture_buf_count, 0, sizeof(s_moisture_buf_count));
+    publish_readings();
 
     /* Load calibration from NVS */
     gophr_sensors_load_calibration();
+    s_rtc_magic = SENSORS_RTC_MAGIC;
 
     ESP_LOGI(TAG, "Sensor subsystem initialized");
     return ESP_OK;
 }
 
-/* ---------- Moisture Reading ---------- */
+/* ---------- Power-up Settling ---------- */
 
-esp_err_t gophr_sensors_read_moisture(void)
+esp_err_t gophr_sensors_wait_settled(uint32_t timeout_ms)
 {
+    gophr_settle_t settle[MOISTURE_SENSOR_COUNT];
     for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
-        float voltage = gophr_adc_read_voltage(s_moisture_gpio[i]);
+        gophr_settle_reset(&settle[i]);
+    }
 
-        /* Drop NaN or out-of-range readings */
-        if (isnan(voltage) || voltage < 0.0f || voltage > 3.3f) {
-            ESP_LOGW(TAG, "Moisture %d: invalid reading %.3fV, dropped", i + 1, voltage);
-            continue;
+    uint32_t start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t elapsed_ms = 0;
+    int ready = 0;
+
+    while (ready < MOISTURE_SENSOR_COUNT && elapsed_ms < timeout_ms) {
+        gophr_adc_snapshot_t snap;
+        gophr_adc_read_snapshot(&snap);
+        elapsed_ms = xTaskGetTickCount() * portTICK_PERIOD_MS - start_ms;
+
+        ready = 0;
+        for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
+            bool was_ready = settle[i].ready;
+            if (gophr_settle_push(&settle[i], &s_moisture_settle_cfg[i], elapsed_ms,
+                                  snap.voltage[s_moisture_gpio[i]])) {
+                ready++;
+                if (!was_ready) {
+                    ESP_LOGI(TAG, "Moisture %d settled after %lums (%.3fV)", i + 1,
+                             (unsigned long)elapsed_ms, snap.voltage[s_moisture_gpio[i]]);
+                }
+            }
         }
 
-        /* Add to median filter buffer */
-        int idx = s_moisture_buf_idx[i];
-        s_moisture_buf[i][idx] = voltage;
-        s_moisture_buf_idx[i] = (idx + 1) % MEDIAN_FILTER_WINDOW;
-        if (s_moisture_buf_count[i] < MEDIAN_FILTER_WINDOW) {
-            s_moisture_buf_count[i]++;
+        if (ready < MOISTURE_SENSOR_COUNT) {
+            vTaskDelay(pdMS_TO_TICKS(SETTLE_SAMPLE_MS));
         }
+    }
 
-        /* Apply median filter */
-        float filtered = median_filter(s_moisture_buf[i], s_moisture_buf_count[i]);
+    /* Settling already covers what skip_initial is for */
+    for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
+        s_moisture_filter[i].skipped = s_moisture_filter_cfg[i].skip_initial;
+    }
+
+    return (ready == MOISTURE_SENSOR_COUNT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+/* ---------- Moisture Reading ---------- */
+
+static void process_moisture(const gophr_adc_snapshot_t *snap)
+{
+    for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
+        float voltage = snap->voltage[s_moisture_gpio[i]];
+
+        /* skip_initial -> range gate -> median -> delta -> EMA */
+        float filtered;
+        gophr_filter_result_t res = gophr_filter_push(&s_moisture_filter[i],
+                                                      &s_moisture_filter_cfg[i],
+                                                      voltage, &filtered);
+        if (res == GOPHR_FILTER_REJECTED) {
+            ESP_LOGW(TAG, "Moisture %d: invalid reading %.3fV, dropped", i + 1, voltage);
+            continue;
+        }
+        if (res != GOPHR_FILTER_PUBLISH) {
+            continue;
+        }
         s_readings.moisture_voltage[i] = filtered;
 
         /* Calculate moisture percentage */
@@ -182,16 +334,23 @@ esp_err_t gophr_sensors_read_moisture(void)
         ESP_LOGD(TAG, "Moisture %d: raw=%.3fV, filtered=%.3fV, pct=%.0f%%",
                  i + 1, voltage, filtered, pct);
     }
+}
 
-    return ESP_OK;
+esp_err_t gophr_sensors_read_moisture(void)
+{
+    gophr_adc_snapshot_t snap;
+    esp_err_t ret = gophr_adc_read_snapshot(&snap);
+    process_moisture(&snap);
+    publish_readings();
+    return ret;
 }
 
 /* ---------- Power Reading ---------- */
 
-esp_err_t gophr_sensors_read_power(void)
+static void process_power(const gophr_adc_snapshot_t *snap)
 {
     /* Battery voltage (with voltage divider correction) */
-    float bat_raw = gophr_adc_read_voltage(GPIO_BATTERY_VOLTAGE);
+    float bat_raw = snap->voltage[GPIO_BATTERY_VOLTAGE];
     if (!isnan(bat_raw)) {
         s_readings.battery_voltage = bat_raw * BATTERY_DIVIDER_RATIO;
 
@@ -204,7 +363,7 @@ esp_err_t gophr_sensors_read_power(void)
     }
 
     /* Solar voltage (with voltage divider correction) */
-    float sol_raw = gophr_adc_read_voltage(GPIO_SOLAR_VOLTAGE);
+    float sol_raw = snap->voltage[GPIO_SOLAR_VOLTAGE];
     if (!isnan(sol_raw)) {
         s_readings.solar_voltage = sol_raw * BATTERY_DIVIDER_RATIO;
         s_readings.solar_charging = s_readings.solar_voltage > SOLAR_CHARGING_THRESHOLD;
@@ -213,18 +372,53 @@ esp_err_t gophr_sensors_read_power(void)
     ESP_LOGD(TAG, "Battery: %.2fV (%.0f%%), Solar: %.2fV (%s)",
              s_readings.battery_voltage, s_readings.battery_percent,
              s_readings.solar_voltage, s_readings.solar_charging ? "charging" : "not charging");
-    return ESP_OK;
+}
+
+esp_err_t gophr_sensors_read_power(void)
+{
+    gophr_adc_snapshot_t snap;
+    esp_err_t ret = gophr_adc_read_snapshot(&snap);
+    process_power(&snap);
+    publish_readings();
+    return ret;
+}
+
+/* ---------- Combined ADC Reading ---------- */
+
+esp_err_t gophr_sensors_read_adc(void)
+{
+    gophr_adc_snapshot_t snap;
+    esp_err_t ret = gophr_adc_read_snapshot(&snap);
+    process_moisture(&snap);
+    process_power(&snap);
+    publish_readings();
+    return ret;
+}
+
+esp_err_t gophr_sensors_read_burst(void)
+{
+    esp_err_t ret = ESP_OK;
+    for (int n = 0; n < MEDIAN_FILTER_WINDOW && ret == ESP_OK; n++) {
+        ret = gophr_sensors_read_adc();
+    }
+    return ret;
 }
 
 /* ---------- AHT20 Reading ---------- */
 
+esp_err_t gophr_sensors_trigger_aht20(void)
+{
+    return gophr_aht20_trigger();
+}
+
 esp_err_t gophr_sensors_read_aht20(void)
 {
     float temp, hum;
-    esp_err_t ret = gophr_aht20_read(&temp, &hum);
+    esp_err_t ret = gophr_aht20_collect(&temp, &hum);
     if (ret == ESP_OK) {
         s_readings.temperature = temp;
         s_readings.humidity = hum;
+        publish_readings();
         ESP_LOGD(TAG, "AHT20: temp=%.1f°C, humidity=%.1f%%", temp, hum);
     }
     return ret;
@@ -232,11 +426,6 @@ esp_err_t gophr_sensors_read_aht20(void)
 
 /* ---------- Getters ---------- */
 
-const sensor_readings_t *gophr_sensors_get_readings(void)
-{
-    return &s_readings;
-}
-
 const moisture_cal_t *gophr_sensors_get_calibration(int sensor_index)
 {
     if (sensor_index < 0 || sensor_index >= MOISTURE_SENSOR_COUNT) return NULL;
@@ -249,7 +438,9 @@ esp_err_t gophr_sensors_calibrate_dry(int sensor_index)
 {
     if (sensor_index < 0 || sensor_index >= MOISTURE_SENSOR_COUNT) return ESP_ERR_INVALID_ARG;
 
-    s_calibration[sensor_index].dry_value = s_readings.moisture_voltage[sensor_index];
+    sensor_readings_t readings;
+    gophr_sensors_get_readings(&readings);
+    s_calibration[sensor_index].dry_value = readings.moisture_voltage[sensor_index];
     snprintf(s_calibration[sensor_index].dry_timestamp, sizeof(s_calibration[sensor_index].dry_timestamp),
              "Calibrated");
 
@@ -263,7 +454,9 @@ esp_err_t gophr_sensors_calibrate_wet(int sensor_index)
 {
     if (sensor_index < 0 || sensor_index >= MOISTURE_SENSOR_COUNT) return ESP_ERR_INVALID_ARG;
 
-    s_calibration[sensor_index].wet_value = s_readings.moisture_voltage[sensor_index];
+    sensor_readings_t readings;
+    gophr_sensors_get_readings(&readings);
+    s_calibration[sensor_index].wet_value = readings.moisture_voltage[sensor_index];
     snprintf(s_calibration[sensor_index].wet_timestamp, sizeof(s_calibration[sensor_index].wet_timestamp),
              "Calibrated");
 
@@ -275,15 +468,9 @@ esp_err_t gophr_sensors_calibrate_wet(int sensor_index)
 
 esp_err_t gophr_sensors_factory_reset_calibration(void)
 {
-    const float defaults[MOISTURE_SENSOR_COUNT][2] = {
-        {FACTORY_S1_DRY, FACTORY_S1_WET},
-        {FACTORY_S2_DRY, FACTORY_S2_WET},
-        {FACTORY_S3_DRY, FACTORY_S3_WET},
-    };
-
     for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
-        s_calibration[i].dry_value = defaults[i][0];
-        s_calibration[i].wet_value = defaults[i][1];
+        s_calibration[i].dry_value = s_factory_cal[i][0];
+        s_calibration[i].wet_value = s_factory_cal[i][1];
         strcpy(s_calibration[i].dry_timestamp, "Factory");
         strcpy(s_calibration[i].wet_timestamp, "Factory");
     }
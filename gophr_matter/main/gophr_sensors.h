@@ -10,9 +10,6 @@ extern "C" {
 /* Number of moisture sensor channels */
 #define MOISTURE_SENSOR_COUNT   3
 
-/* Median filter window size */
-#define MEDIAN_FILTER_WINDOW    5
-
 /* Battery voltage range for percentage calculation */
 #define BATTERY_VOLTAGE_MIN     3.0f   /* 0% */
 #define BATTERY_VOLTAGE_MAX     4.2f   /* 100% */
@@ -21,6 +18,11 @@ extern "C" {
 /* Solar charging threshold */
 #define SOLAR_CHARGING_THRESHOLD 1.0f  /* Volts (after divider correction) */
 
+/* Power-up settling: sample period and give-up time */
+#define SETTLE_SAMPLE_MS        250
+#define SETTLE_TIMEOUT_MS       30000
+#define RESETTLE_TIMEOUT_MS     3000   /* Rail back up between scheduler windows */
+
 /* Factory default calibration values */
 #define FACTORY_S1_DRY          1.979f
 #define FACTORY_S1_WET          1.388f
@@ -49,20 +51,36 @@ typedef struct {
     float humidity;
 } sensor_readings_t;
 
-/* Initialize sensor subsystem, load calibration from NVS */
+/* Initialize sensor subsystem, load calibration from NVS (RTC memory on warm wake) */
 esp_err_t gophr_sensors_init(void);
 
+/*
+ * Sample the moisture rails until every channel's slope and noise are below
+ * the settling thresholds (or timeout_ms passes). Returns ESP_ERR_TIMEOUT if
+ * any channel did not settle. Settling replaces the filters' skip_initial.
+ */
+esp_err_t gophr_sensors_wait_settled(uint32_t timeout_ms);
+
 /* Read all moisture sensors (applies median filter) */
 esp_err_t gophr_sensors_read_moisture(void);
 
 /* Read battery and solar voltages */
 esp_err_t gophr_sensors_read_power(void);
 
-/* Read AHT20 temperature and humidity */
+/* Read moisture, battery and solar from a single ADC scan */
+esp_err_t gophr_sensors_read_adc(void);
+
+/* Fill the moisture median windows from back-to-back ADC scans (one filtered set) */
+esp_err_t gophr_sensors_read_burst(void);
+
+/* Start an AHT20 conversion so it runs while the ADC is scanning */
+esp_err_t gophr_sensors_trigger_aht20(void);
+
+/* Read AHT20 temperature and humidity (collects a triggered conversion) */
 esp_err_t gophr_sensors_read_aht20(void);
 
-/* Get current sensor readings */
-const sensor_readings_t *gophr_sensors_get_readings(void);
+/* Copy a consistent snapshot of the current readings (lock-free, any task) */
+void gophr_sensors_get_readings(sensor_readings_t *out);
 
 /* Calibration */
 esp_err_t gophr_sensors_calibrate_dry(int sensor_index);
@@ -70,7 +88,7 @@ esp_err_t gophr_sensors_calibrate_wet(int sensor_index);
 esp_err_t gophr_sensors_factory_reset_calibration(void);
 const moisture_cal_t *gophr_sensors_get_calibration(int sensor_index);
 
-/* Save/load calibration to NVS */
+/* Save/load calibration to NVS (save is write-behind, see gophr_persist.h) */
 esp_err_t gophr_sensors_save_calibration(void);
 esp_err_t gophr_sensors_load_calibration(void);
 
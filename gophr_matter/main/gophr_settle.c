@@ -0,0 +1,50 @@
+#include "gophr_settle.h"
+
+#include <string.h>
+#include <math.h>
+
+void gophr_settle_reset(gophr_settle_t *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+bool gophr_settle_push(gophr_settle_t *s, const gophr_settle_cfg_t *cfg,
+                       uint32_t time_ms, float voltage)
+{
+    if (s->ready) return true;
+    if (isnan(voltage)) return false;
+
+    s->value[s->head] = voltage;
+    s->time_ms[s->head] = time_ms;
+    s->head = (uint8_t)((s->head + 1) % GOPHR_SETTLE_WINDOW);
+    if (s->count < GOPHR_SETTLE_WINDOW) s->count++;
+    if (s->count < GOPHR_SETTLE_WINDOW) return false;
+
+    /* Mean of time (relative to the oldest sample, in seconds) and voltage */
+    uint32_t t0 = s->time_ms[s->head];
+    float mean_t = 0.0f, mean_v = 0.0f;
+    for (int i = 0; i < GOPHR_SETTLE_WINDOW; i++) {
+        mean_t += (float)(s->time_ms[i] - t0) / 1000.0f;
+        mean_v += s->value[i];
+    }
+    mean_t /= GOPHR_SETTLE_WINDOW;
+    mean_v /= GOPHR_SETTLE_WINDOW;
+
+    if (mean_v < cfg->min_voltage) return false;
+
+    /* Least-squares slope and variance about the mean */
+    float stt = 0.0f, stv = 0.0f, svv = 0.0f;
+    for (int i = 0; i < GOPHR_SETTLE_WINDOW; i++) {
+        float dt = (float)(s->time_ms[i] - t0) / 1000.0f - mean_t;
+        float dv = s->value[i] - mean_v;
+        stt += dt * dt;
+        stv += dt * dv;
+        svv += dv * dv;
+    }
+    float slope = (stt > 0.0f) ? stv / stt : 0.0f;
+    float variance = svv / GOPHR_SETTLE_WINDOW;
+
+    s->ready = fabsf(slope) <= cfg->max_slope &&
+               variance <= cfg->max_stddev * cfg->max_stddev;
+    return s->ready;
+}
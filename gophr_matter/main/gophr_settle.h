@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Samples used for each slope/variance estimate */
+#ifndef GOPHR_SETTLE_WINDOW
+#define GOPHR_SETTLE_WINDOW     8
+#endif
+
+/* Settling thresholds for one channel */
+typedef struct {
+    float min_voltage;      /* Channel must read at least this (probe powered and in soil) */
+    float max_slope;        /* Least-squares slope across the window, V/s */
+    float max_stddev;       /* Standard deviation across the window, V */
+} gophr_settle_cfg_t;
+
+/* Defaults: >0.9V (the old fixed check), flatter than 10mV/s, noise under 10mV */
+#define GOPHR_SETTLE_CFG_DEFAULT()                              \
+    {                                                           \
+        .min_voltage = 0.9f,                                    \
+        .max_slope = 0.01f,                                     \
+        .max_stddev = 0.01f,                                    \
+    }
+
+/* Per-channel detector state */
+typedef struct {
+    float value[GOPHR_SETTLE_WINDOW];
+    uint32_t time_ms[GOPHR_SETTLE_WINDOW];
+    uint8_t head;
+    uint8_t count;
+    bool ready;
+} gophr_settle_t;
+
+/* Clear a channel's detector */
+void gophr_settle_reset(gophr_settle_t *s);
+
+/*
+ * Add a sample taken at time_ms (NaN samples are ignored).
+ * Returns true once the channel has settled; stays true until reset.
+ */
+bool gophr_settle_push(gophr_settle_t *s, const gophr_settle_cfg_t *cfg,
+                       uint32_t time_ms, float voltage);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Awake-time phase tracer. Each phase is stamped once per wake (the first
+ * time it is reached) with esp_timer_get_time(), relative to boot, or to the
+ * end of the previous light sleep. Stamps and per-phase statistics live in
+ * RTC memory, so the statistics roll across deep sleeps.
+ *
+ * gophr_trace_emit() logs one line per wake, meant for host scripts:
+ *
+ *   GTRACE v1 wake=<n> <phase>=<last>,<avg>,<min>,<max> ...
+ *
+ * Every phase is listed in enum order. All times are milliseconds from the
+ * start of the wake. <last> is "-" if the phase was not reached this wake.
+ * <avg> is an exponential moving average (weight 1/GOPHR_TRACE_AVG_WEIGHT)
+ * and, like <min> and <max>, is "-" until the phase has been reached once.
+ */
+
+typedef enum {
+    GOPHR_PHASE_BOOT,       /* app_main() entered */
+    GOPHR_PHASE_INIT,       /* Hardware and sensors ready */
+    GOPHR_PHASE_STACK,      /* Network stack started */
+    GOPHR_PHASE_JOINED,     /* On the network */
+    GOPHR_PHASE_REPORT,     /* First attribute update handed to the stack */
+    GOPHR_PHASE_SLEEP_SEQ,  /* Sleep sequence started */
+    GOPHR_PHASE_SLEEP,      /* Reports flushed, sleeping */
+    GOPHR_PHASE_SKIP,       /* Timer wake skipped, sleeping without the radio */
+    GOPHR_PHASE_COUNT,
+} gophr_phase_t;
+
+#define GOPHR_TRACE_AVG_WEIGHT  8
+
+/* Start a wake: first call after boot counts from boot, later calls from now */
+void gophr_trace_start(void);
+
+/* Stamp a phase (no-op if already stamped this wake) */
+void gophr_trace_mark(gophr_phase_t phase);
+
+/* Fold this wake into the statistics and log the GTRACE line (once per wake) */
+void gophr_trace_emit(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,43 @@
+#include "gophr_wakegate.h"
+
+#include <string.h>
+
+#define WAKEGATE_MAGIC  0x4757474B  /* "GWGK" */
+
+void gophr_wakegate_reset(gophr_wakegate_t *g)
+{
+    memset(g, 0, sizeof(*g));
+}
+
+static bool moved(const gophr_wakegate_t *g, const gophr_wakegate_cfg_t *cfg,
+                  const uint16_t moisture[GOPHR_WAKEGATE_CHANNELS])
+{
+    for (int i = 0; i < GOPHR_WAKEGATE_CHANNELS; i++) {
+        int diff = (int)moisture[i] - (int)g->reported[i];
+        if (diff < 0) diff = -diff;
+        if (diff > cfg->delta) return true;
+    }
+    return false;
+}
+
+bool gophr_wakegate_sample(gophr_wakegate_t *g, const gophr_wakegate_cfg_t *cfg,
+                           const uint16_t moisture[GOPHR_WAKEGATE_CHANNELS])
+{
+    if (g->magic != WAKEGATE_MAGIC) {
+        gophr_wakegate_reset(g);
+        return true;
+    }
+
+    if (moved(g, cfg, moisture) || g->skipped >= cfg->max_skips) {
+        return true;
+    }
+    g->skipped++;
+    return false;
+}
+
+void gophr_wakegate_reported(gophr_wakegate_t *g, const uint16_t moisture[GOPHR_WAKEGATE_CHANNELS])
+{
+    memcpy(g->reported, moisture, sizeof(g->reported));
+    g->skipped = 0;
+    g->magic = WAKEGATE_MAGIC;
+}
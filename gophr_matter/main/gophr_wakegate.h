@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Wake gating for timer wakes: decide from a fresh moisture sample whether
+ * this wake is worth bringing the radio up for. A wake reports when any
+ * channel has moved more than `delta` from the value last reported, or
+ * when `max_skips` wakes in a row have been skipped. Comparing against the
+ * last reported value (not the previous sample) lets slow drift add up.
+ * A skipped sample is not kept: it is within `delta` of what the network
+ * already has, and readings taken off the network go to the sample log.
+ *
+ * Plain C with no IDF dependencies; the caller keeps the state in RTC
+ * memory so it survives deep sleep.
+ */
+
+#define GOPHR_WAKEGATE_CHANNELS     3
+
+/* Defaults: 2% moisture change, report at least every 6h */
+#define GOPHR_WAKEGATE_DELTA        200     /* 0.01% units */
+#define GOPHR_WAKEGATE_MAX_INTERVAL_MIN 360
+
+typedef struct {
+    uint16_t delta;         /* Per-channel change that forces a report (0.01%) */
+    uint16_t max_skips;     /* Report after this many skipped wakes in a row */
+} gophr_wakegate_cfg_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t reported[GOPHR_WAKEGATE_CHANNELS];     /* Last reported sample */
+    uint16_t skipped;       /* Wakes skipped since the last report */
+} gophr_wakegate_t;
+
+/* Forget everything; the next sample reports */
+void gophr_wakegate_reset(gophr_wakegate_t *g);
+
+/*
+ * Record a sample and decide. Returns true if the wake should report (the
+ * caller then calls gophr_wakegate_reported once it has), false if it can
+ * go back to sleep. Invalid state (e.g. after power loss) always reports.
+ */
+bool gophr_wakegate_sample(gophr_wakegate_t *g, const gophr_wakegate_cfg_t *cfg,
+                           const uint16_t moisture[GOPHR_WAKEGATE_CHANNELS]);
+
+/* The sample was delivered: make it the new reference */
+void gophr_wakegate_reported(gophr_wakegate_t *g, const uint16_t moisture[GOPHR_WAKEGATE_CHANNELS]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+/*
+ * Minimal check macros for the host tests. A failed check is printed and
+ * counted; the test keeps going and TEST_EXIT() returns non-zero at the end.
+ */
+
+static int s_test_failures;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            s_test_failures++;                                              \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                      \
+    do {                                                                    \
+        long long _a = (long long)(a), _b = (long long)(b);                 \
+        if (_a != _b) {                                                     \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s == %lld, %s == %lld\n", \
+                    __FILE__, __LINE__, #a, _a, #b, _b);                    \
+            s_test_failures++;                                              \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_NEAR(a, b, eps)                                               \
+    do {                                                                    \
+        double _a = (double)(a), _b = (double)(b);                          \
+        if (!(fabs(_a - _b) <= (eps))) {                                    \
+            fprintf(stderr, "%s:%d: CHECK_NEAR failed: %s == %g, %s == %g\n", \
+                    __FILE__, __LINE__, #a, _a, #b, _b);                    \
+            s_test_failures++;                                              \
+        }                                                                   \
+    } while (0)
+
+#define TEST_EXIT()                                                         \
+    do {                                                                    \
+        if (s_test_failures) fprintf(stderr, "%d check(s) failed\n", s_test_failures); \
+        return s_test_failures ? 1 : 0;                                     \
+    } while (0)
+
+/* Monotonic time in seconds, for the benchmarks */
+static inline double test_now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Deterministic PRNG so failures reproduce (xorshift32) */
+static inline uint32_t test_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/* Uniform in [-1, 1) */
+static inline float test_noise(uint32_t *state)
+{
+    return (float)(test_rand(state) & 0xFFFFFF) / (float)0x800000 - 1.0f;
+}
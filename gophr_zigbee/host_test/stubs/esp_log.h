@@ -0,0 +1,26 @@
+#pragma once
+
+/*
+ * Host stand-in for ESP-IDF's esp_log.h. Errors and warnings go to stderr,
+ * lower levels are compiled (so arguments stay checked) but not printed
+ * unless FAKE_LOG_LEVEL is raised.
+ */
+
+#include <stdio.h>
+
+#ifndef FAKE_LOG_LEVEL
+#define FAKE_LOG_LEVEL  2       /* 1 error, 2 warning, 3 info, 4 debug, 5 verbose */
+#endif
+
+#define FAKE_LOG(level, letter, tag, format, ...)                           \
+    do {                                                                    \
+        if ((level) <= FAKE_LOG_LEVEL) {                                    \
+            fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__); \
+        }                                                                   \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) FAKE_LOG(1, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) FAKE_LOG(2, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) FAKE_LOG(3, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) FAKE_LOG(4, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) FAKE_LOG(5, "V", tag, format, ##__VA_ARGS__)
@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+ * Host stand-in for ESP-IDF's esp_partition.h, backed by RAM. Writes behave
+ * like NOR flash (they can only clear bits), erases must be sector aligned,
+ * and a write can be cut short to simulate power loss.
+ */
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define FAKE_PARTITION_SECTOR_SIZE  4096
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef int esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size);
+
+/* ---------- Test Control ---------- */
+
+/* Create (or replace) the one fake partition, fully erased */
+const esp_partition_t *fake_partition_create(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                             const char *label, uint32_t size);
+
+/* Remove the fake partition (find_first returns NULL) */
+void fake_partition_destroy(void);
+
+/* Raw contents, for checks and for corrupting records by hand */
+uint8_t *fake_partition_data(void);
+
+/* Power loss: the next write stores only its first `bytes` bytes and fails; -1 = off */
+void fake_partition_cut_write(int bytes);
+
+/* Sector erases since creation (wear) */
+uint32_t fake_partition_erase_count(uint32_t sector);
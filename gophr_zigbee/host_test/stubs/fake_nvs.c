@@ -0,0 +1,96 @@
+#include "nvs.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#define FAKE_NVS_ENTRIES    32
+#define FAKE_NVS_NAME_LEN   16      /* NVS_KEY_NAME_MAX_SIZE */
+
+typedef struct {
+    char ns[FAKE_NVS_NAME_LEN];
+    char key[FAKE_NVS_NAME_LEN];
+    uint32_t value;
+    bool used;
+} fake_entry_t;
+
+/* A handle is the index of its namespace in this table, plus one */
+static char s_namespaces[FAKE_NVS_ENTRIES][FAKE_NVS_NAME_LEN];
+static fake_entry_t s_entries[FAKE_NVS_ENTRIES];
+
+void fake_nvs_erase_all(void)
+{
+    memset(s_namespaces, 0, sizeof(s_namespaces));
+    memset(s_entries, 0, sizeof(s_entries));
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!name || strlen(name) >= FAKE_NVS_NAME_LEN) return ESP_ERR_INVALID_ARG;
+
+    for (int i = 0; i < FAKE_NVS_ENTRIES; i++) {
+        if (strcmp(s_namespaces[i], name) == 0) {
+            *out_handle = (nvs_handle_t)i + 1;
+            return ESP_OK;
+        }
+    }
+    if (open_mode == NVS_READONLY) return ESP_ERR_NVS_NOT_FOUND;
+
+    for (int i = 0; i < FAKE_NVS_ENTRIES; i++) {
+        if (!s_namespaces[i][0]) {
+            strcpy(s_namespaces[i], name);
+            *out_handle = (nvs_handle_t)i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+}
+
+static fake_entry_t *find(nvs_handle_t handle, const char *key)
+{
+    if (handle == 0 || handle > FAKE_NVS_ENTRIES) return NULL;
+    const char *ns = s_namespaces[handle - 1];
+    for (int i = 0; i < FAKE_NVS_ENTRIES; i++) {
+        if (s_entries[i].used && strcmp(s_entries[i].ns, ns) == 0 && strcmp(s_entries[i].key, key) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    fake_entry_t *e = find(handle, key);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    *out_value = e->value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    if (handle == 0 || handle > FAKE_NVS_ENTRIES || strlen(key) >= FAKE_NVS_NAME_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    fake_entry_t *e = find(handle, key);
+    for (int i = 0; i < FAKE_NVS_ENTRIES && !e; i++) {
+        if (!s_entries[i].used) {
+            e = &s_entries[i];
+            e->used = true;
+            strcpy(e->ns, s_namespaces[handle - 1]);
+            strcpy(e->key, key);
+        }
+    }
+    if (!e) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    e->value = value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
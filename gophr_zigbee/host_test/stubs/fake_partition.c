@@ -0,0 +1,97 @@
+#include "esp_partition.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static esp_partition_t s_part;
+static uint8_t *s_data;
+static uint32_t *s_erases;
+static int s_cut = -1;
+
+const esp_partition_t *fake_partition_create(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                             const char *label, uint32_t size)
+{
+    fake_partition_destroy();
+    s_part.type = type;
+    s_part.subtype = subtype;
+    s_part.address = 0x110000;
+    s_part.size = size;
+    strncpy(s_part.label, label, sizeof(s_part.label) - 1);
+    s_data = malloc(size);
+    s_erases = calloc(size / FAKE_PARTITION_SECTOR_SIZE + 1, sizeof(*s_erases));
+    memset(s_data, 0xFF, size);
+    s_cut = -1;
+    return &s_part;
+}
+
+void fake_partition_destroy(void)
+{
+    free(s_data);
+    free(s_erases);
+    s_data = NULL;
+    s_erases = NULL;
+}
+
+uint8_t *fake_partition_data(void)
+{
+    return s_data;
+}
+
+void fake_partition_cut_write(int bytes)
+{
+    s_cut = bytes;
+}
+
+uint32_t fake_partition_erase_count(uint32_t sector)
+{
+    return s_erases ? s_erases[sector] : 0;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    if (!s_data || type != s_part.type || subtype != s_part.subtype) return NULL;
+    if (label && strcmp(label, s_part.label) != 0) return NULL;
+    return &s_part;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t size)
+{
+    if (part != &s_part || !s_data) return ESP_ERR_INVALID_ARG;
+    if (offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, s_data + offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t size)
+{
+    if (part != &s_part || !s_data) return ESP_ERR_INVALID_ARG;
+    if (offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+
+    size_t n = size;
+    if (s_cut >= 0 && (size_t)s_cut < n) n = (size_t)s_cut;
+
+    /* NOR flash: programming only clears bits */
+    const uint8_t *p = src;
+    for (size_t i = 0; i < n; i++) {
+        s_data[offset + i] &= p[i];
+    }
+
+    if (s_cut >= 0) {
+        s_cut = -1;
+        if (n < size) return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size)
+{
+    if (part != &s_part || !s_data) return ESP_ERR_INVALID_ARG;
+    if (offset % FAKE_PARTITION_SECTOR_SIZE || size % FAKE_PARTITION_SECTOR_SIZE) return ESP_ERR_INVALID_ARG;
+    if (offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+    memset(s_data + offset, 0xFF, size);
+    for (size_t s = offset / FAKE_PARTITION_SECTOR_SIZE; s < (offset + size) / FAKE_PARTITION_SECTOR_SIZE; s++) {
+        s_erases[s]++;
+    }
+    return ESP_OK;
+}
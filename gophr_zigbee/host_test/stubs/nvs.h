@@ -0,0 +1,31 @@
+#pragma once
+
+/*
+ * Host stand-in for ESP-IDF's nvs.h: u32 values only, kept in RAM. The
+ * store outlives a simulated reboot; fake_nvs_erase_all() wipes it.
+ */
+
+#include "esp_err.h"
+#include <stdint.h>
+
+#define ESP_ERR_NVS_BASE        0x1100
+#define ESP_ERR_NVS_NOT_FOUND   (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE (ESP_ERR_NVS_BASE + 0x05)
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle);
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value);
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value);
+esp_err_t nvs_commit(nvs_handle_t handle);
+void nvs_close(nvs_handle_t handle);
+
+/* ---------- Test Control ---------- */
+
+/* Forget every namespace and key */
+void fake_nvs_erase_all(void);
@@ -0,0 +1,227 @@
+/*
+ * Duty-cycle policy test: the bounds and the charging ramp on hand-made
+ * states, then a month of simulated weather (solar over the day, cloudy
+ * and dark spells) on a small battery, run once with the adaptive policy
+ * and once with the fixed user settings. Reports how long each lasts and
+ * how many wakes it gets in.
+ */
+
+#include "gophr_duty.h"
+#include "gophr_energy.h"
+#include "host_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NOMINAL_MIN         60      /* GOPHR_DEFAULT_SLEEP_DURATION_MIN */
+#define MIN_AWAKE_MIN       1       /* GOPHR_DEFAULT_MIN_AWAKE_MIN */
+
+#define MONTH_MIN           (30 * 24 * 60)
+#define BATTERY_UAH         600000  /* Small LiPo */
+#define PANEL_PEAK_UA       40000   /* Into the battery at noon, full sun */
+#define CHARGING_UA         2000    /* Charger status pin threshold */
+#define WAKE_BASE_S         20      /* Read, report, settle even with no window */
+
+/* Awake current: CPU, radio and every sensor rail */
+#define AWAKE_UA    (GOPHR_ENERGY_CPU_ACTIVE_UA + GOPHR_ENERGY_RADIO_UA + GOPHR_ENERGY_SENSOR_RAIL_UA + \
+                     GOPHR_ENERGY_AHT20_RAIL_UA + GOPHR_ENERGY_LED_RAIL_UA)
+
+static const gophr_duty_settings_t s_settings = {
+    .sleep_min = NOMINAL_MIN,
+    .min_awake_min = MIN_AWAKE_MIN,
+};
+
+static gophr_duty_state_t state_at(float soc, bool charging, int tighten_pm)
+{
+    gophr_duty_state_t st = {
+        .battery_percent = soc,
+        .solar_charging = charging,
+        .tighten_pm = tighten_pm,
+    };
+    return st;
+}
+
+/* Every level and dark time stays inside the policy range and the user bounds */
+static void test_bounds(void)
+{
+    static const gophr_duty_settings_t settings[] = {
+        {.sleep_min = NOMINAL_MIN, .min_awake_min = MIN_AWAKE_MIN},
+        {.sleep_min = NOMINAL_MIN, .min_awake_min = 5, .min_interval_min = 45, .max_interval_min = 180},
+        {.sleep_min = 1, .min_awake_min = 0},
+        {.sleep_min = 1440, .min_awake_min = 15, .max_interval_min = 1000},
+        {.sleep_min = 10, .min_awake_min = 1, .min_interval_min = 30},     /* Min above nominal */
+        {.sleep_min = 600, .min_awake_min = 1, .max_interval_min = 120},   /* Max below nominal */
+    };
+    for (size_t i = 0; i < sizeof(settings) / sizeof(settings[0]); i++) {
+        const gophr_duty_settings_t *s = &settings[i];
+        int lo = s->sleep_min / GOPHR_DUTY_MAX_TIGHTEN;
+        int hi = s->sleep_min * GOPHR_DUTY_MAX_STRETCH;
+        if (s->min_interval_min > lo) lo = s->min_interval_min;
+        if (s->max_interval_min && s->max_interval_min < hi) hi = s->max_interval_min;
+        if (lo < GOPHR_DUTY_SLEEP_MIN_MIN) lo = GOPHR_DUTY_SLEEP_MIN_MIN;
+        if (hi > GOPHR_DUTY_SLEEP_MAX_MIN) hi = GOPHR_DUTY_SLEEP_MAX_MIN;
+        if (lo > hi) lo = hi;   /* A user max below the policy range wins */
+
+        for (int soc = -10; soc <= 110; soc += 5) {
+            for (uint32_t dark_h = 0; dark_h <= 200; dark_h += 25) {
+                for (int ramp = 0; ramp <= 1000; ramp += 250) {
+                    gophr_duty_state_t st = state_at((float)soc, dark_h == 0, ramp);
+                    st.dark_min = dark_h * 60;
+                    gophr_duty_t d = gophr_duty_policy(&st, s);
+                    CHECK(d.sleep_min >= lo && d.sleep_min <= hi);
+                    CHECK(d.min_awake_min >= 0 && d.min_awake_min <= s->min_awake_min);
+                    CHECK(d.tighten_pm >= 0 && d.tighten_pm <= 1000);
+                }
+            }
+        }
+    }
+}
+
+/* The tightening comes in one step per sleep, and goes out the same way */
+static void test_ramp(void)
+{
+    gophr_duty_state_t st = state_at(100, true, 0);
+    int sleeps = 0, last = NOMINAL_MIN;
+    gophr_duty_t d;
+    do {
+        d = gophr_duty_policy(&st, &s_settings);
+        CHECK(d.sleep_min <= last);
+        last = d.sleep_min;
+        st.tighten_pm = d.tighten_pm;
+        sleeps++;
+    } while (d.tighten_pm < 1000 && sleeps < 100);
+    CHECK_EQ(sleeps, 1000 / GOPHR_DUTY_TIGHTEN_STEP);
+    CHECK_EQ(d.sleep_min, NOMINAL_MIN / GOPHR_DUTY_MAX_TIGHTEN);
+
+    st.solar_charging = false;
+    sleeps = 0;
+    do {
+        d = gophr_duty_policy(&st, &s_settings);
+        st.tighten_pm = d.tighten_pm;
+        sleeps++;
+    } while (d.tighten_pm > 0 && sleeps < 100);
+    CHECK_EQ(sleeps, 1000 / GOPHR_DUTY_TIGHTEN_STEP);
+    CHECK_EQ(d.sleep_min, NOMINAL_MIN);
+
+    /* A flickering charger at full charge moves the interval by one step at most */
+    int step = (NOMINAL_MIN * (1000 - 1000 / GOPHR_DUTY_MAX_TIGHTEN) / 1000) * GOPHR_DUTY_TIGHTEN_STEP / 1000 + 1;
+    uint32_t seed = 0x5eed;
+    st = state_at(100, false, 0);
+    last = NOMINAL_MIN;
+    int worst = 0;
+    for (int i = 0; i < 1000; i++) {
+        st.solar_charging = test_rand(&seed) & 1;
+        d = gophr_duty_policy(&st, &s_settings);
+        st.tighten_pm = d.tighten_pm;
+        if (abs(d.sleep_min - last) > worst) worst = abs(d.sleep_min - last);
+        last = d.sleep_min;
+    }
+    CHECK(worst <= step);
+}
+
+/* ---------- Month simulation ---------- */
+
+typedef enum { SUNNY, CLOUDY, DARK } weather_t;
+
+typedef struct {
+    int wakes;
+    int died_min;               /* -1 if it made it through */
+    float min_soc;
+} sim_result_t;
+
+/* Into the battery from the panel at this minute of the month */
+static int32_t solar_ua(int minute, const weather_t *days, uint32_t *seed)
+{
+    int hour = (minute % (24 * 60)) / 60;
+    if (hour < 7 || hour >= 19) return 0;
+    float sun = sinf((float)(minute % (24 * 60) - 7 * 60) / (12 * 60) * 3.14159f);
+    float cover = days[minute / (24 * 60)] == SUNNY ? 1.0f : days[minute / (24 * 60)] == CLOUDY ? 0.15f : 0.0f;
+    float jitter = 1.0f + 0.2f * test_noise(seed);
+    return (int32_t)(PANEL_PEAK_UA * sun * cover * jitter);
+}
+
+static sim_result_t simulate_month(const weather_t *days, float start_soc, bool adaptive, uint32_t seed)
+{
+    sim_result_t r = {.died_min = -1, .min_soc = start_soc};
+    int64_t charge_uamin = (int64_t)(BATTERY_UAH * 60.0 * start_soc / 100.0);
+    const int64_t full_uamin = (int64_t)BATTERY_UAH * 60;
+    uint32_t dark_min = 0;
+    int tighten_pm = 0;
+
+    int minute = 0;
+    while (minute < MONTH_MIN) {
+        float soc = (float)(100.0 * charge_uamin / full_uamin);
+        bool charging = solar_ua(minute, days, &seed) >= CHARGING_UA;
+
+        /* Same bookkeeping as plan_next_sleep() */
+        gophr_duty_state_t st = state_at(soc, charging, tighten_pm);
+        st.dark_min = charging ? 0 : dark_min;
+        gophr_duty_t d = {.sleep_min = s_settings.sleep_min, .min_awake_min = s_settings.min_awake_min};
+        if (adaptive) {
+            d = gophr_duty_policy(&st, &s_settings);
+            tighten_pm = d.tighten_pm;
+        }
+
+        int awake_s = d.min_awake_min * 60 > WAKE_BASE_S ? d.min_awake_min * 60 : WAKE_BASE_S;
+        charge_uamin -= (int64_t)AWAKE_UA * awake_s / 60;
+        r.wakes++;
+
+        for (int m = 0; m < d.sleep_min && minute < MONTH_MIN; m++, minute++) {
+            charge_uamin += solar_ua(minute, days, &seed) - GOPHR_ENERGY_DEEP_SLEEP_UA;
+            if (charge_uamin > full_uamin) charge_uamin = full_uamin;
+        }
+        dark_min = charging ? (uint32_t)d.sleep_min : st.dark_min + (uint32_t)d.sleep_min;
+
+        soc = (float)(100.0 * charge_uamin / full_uamin);
+        if (soc < r.min_soc) r.min_soc = soc;
+        if (charge_uamin <= 0) {
+            r.died_min = minute;
+            break;
+        }
+    }
+    return r;
+}
+
+int main(void)
+{
+    test_bounds();
+    test_ramp();
+
+    static const struct {
+        const char *name;
+        const char *weather;    /* One letter a day: s sunny, c cloudy, d dark */
+        float start_soc;
+    } months[] = {
+        {"sunny", "ssssssssssssssssssssssssssssss", 80},
+        {"mixed", "sscccsscsccccsssccsccccssccscs", 60},
+        {"dark spell", "sssddddddddddddddddddddddddddd", 90},
+        {"grey winter", "cccccccccccccccccccccccccccccc", 50},
+    };
+    sim_result_t adaptive[4], fixed[4];
+    for (size_t i = 0; i < sizeof(months) / sizeof(months[0]); i++) {
+        weather_t days[30];
+        size_t len = strlen(months[i].weather);
+        for (size_t d = 0; d < 30; d++) {
+            char c = months[i].weather[d % len];
+            days[d] = c == 's' ? SUNNY : c == 'c' ? CLOUDY : DARK;
+        }
+        adaptive[i] = simulate_month(days, months[i].start_soc, true, 0xd0d0 + (uint32_t)i);
+        fixed[i] = simulate_month(days, months[i].start_soc, false, 0xd0d0 + (uint32_t)i);
+        for (int p = 0; p < 2; p++) {
+            const sim_result_t *r = p ? &fixed[i] : &adaptive[i];
+            printf("%-12s %-8s %5d wakes, min %5.1f%%, %s", months[i].name, p ? "fixed" : "adaptive",
+                   r->wakes, (double)r->min_soc, r->died_min < 0 ? "ran the month" : "died on day ");
+            if (r->died_min >= 0) printf("%d", r->died_min / (24 * 60) + 1);
+            printf("\n");
+        }
+        /* The adaptive policy never dies first */
+        CHECK(adaptive[i].died_min < 0 || (fixed[i].died_min >= 0 && adaptive[i].died_min >= fixed[i].died_min));
+    }
+
+    /* Sun to spare: spend it on more wakes */
+    CHECK(adaptive[0].died_min < 0 && adaptive[0].wakes > fixed[0].wakes);
+    /* A long dark spell kills the fixed schedule; the adaptive one rides it out */
+    CHECK(fixed[2].died_min >= 0);
+    CHECK(adaptive[2].died_min < 0);
+    TEST_EXIT();
+}
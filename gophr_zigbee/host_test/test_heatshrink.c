@@ -0,0 +1,221 @@
+/*
+ * Compressed OTA stream test.
+ *
+ * Compresses a firmware-like image into a heatshrink stream, then feeds it
+ * to the decoder in OTA-sized blocks the way gophr_ota.c decode_to_flash()
+ * does, writing the output into a fake partition. Between blocks the
+ * decoder state is parked and restored as if it had sat in RTC memory
+ * through a deep sleep. The partition must end up holding the image.
+ */
+
+#include "gophr_heatshrink.h"
+#include "esp_partition.h"
+#include "host_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_SIZE      (96 * 1024)
+#define OTA_BLOCK       223             /* GOPHR_OTA_MAX_DATA_SIZE */
+#define SLOT_SIZE       (128 * 1024)
+
+/* ---------- Encoder (host only) ---------- */
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    uint8_t bit;        /* Next bit in buf[len], 0x80 first */
+} bit_writer_t;
+
+static void put_bits(bit_writer_t *w, uint32_t value, int bits)
+{
+    while (bits--) {
+        if (w->bit == 0) {
+            w->buf[w->len] = 0;
+            w->bit = 0x80;
+        }
+        if (value & (1U << bits)) w->buf[w->len] |= w->bit;
+        w->bit >>= 1;
+        if (w->bit == 0) w->len++;
+    }
+}
+
+/* Greedy LZSS in heatshrink's bit format; returns the compressed length */
+static size_t hs_encode(const uint8_t *in, size_t len, uint8_t *out, int window_sz2, int lookahead_sz2)
+{
+    bit_writer_t w = {.buf = out};
+    size_t window = 1U << window_sz2;
+    size_t max_len = 1U << lookahead_sz2;
+    /* A back-reference has to beat the literals it replaces */
+    size_t min_len = (size_t)(1 + window_sz2 + lookahead_sz2) / 9 + 1;
+
+    for (size_t i = 0; i < len;) {
+        size_t best_len = 0, best_off = 0;
+        for (size_t off = 1; off <= window && off <= i; off++) {
+            size_t n = 0;
+            while (n < max_len && i + n < len && in[i + n] == in[i + n - off]) n++;
+            if (n > best_len) {
+                best_len = n;
+                best_off = off;
+            }
+        }
+        if (best_len >= min_len) {
+            put_bits(&w, 0, 1);
+            put_bits(&w, (uint32_t)(best_off - 1), window_sz2);
+            put_bits(&w, (uint32_t)(best_len - 1), lookahead_sz2);
+            i += best_len;
+        } else {
+            put_bits(&w, 1, 1);
+            put_bits(&w, in[i], 8);
+            i++;
+        }
+    }
+    return w.len + (w.bit ? 1 : 0);
+}
+
+/* Code-like content: repeated instruction patterns, tables and some noise */
+static void make_image(uint8_t *img, size_t len, uint32_t seed)
+{
+    static const uint8_t prologue[] = {0x13, 0x01, 0x01, 0xff, 0x23, 0x26, 0x11, 0x00, 0x23, 0x24, 0x81, 0x00};
+    for (size_t i = 0; i < len;) {
+        uint32_t r = test_rand(&seed) % 4;
+        size_t n;
+        if (r == 0) {
+            n = sizeof(prologue) < len - i ? sizeof(prologue) : len - i;
+            memcpy(img + i, prologue, n);
+        } else if (r == 1) {
+            n = 1 + test_rand(&seed) % 32;
+            if (n > len - i) n = len - i;
+            for (size_t k = 0; k < n; k++) img[i + k] = (uint8_t)test_rand(&seed);
+        } else {
+            /* Copy of something recent */
+            size_t back = 1 + test_rand(&seed) % 900;
+            n = 3 + test_rand(&seed) % 40;
+            if (n > len - i) n = len - i;
+            for (size_t k = 0; k < n; k++) img[i + k] = i + k >= back ? img[i + k - back] : 0;
+        }
+        i += n;
+    }
+}
+
+/* ---------- OTA-style streaming ---------- */
+
+typedef struct {
+    const esp_partition_t *part;
+    uint32_t write_offset;
+    uint32_t erased_to;
+    uint32_t raw_size;
+} slot_writer_t;
+
+static esp_err_t slot_write(slot_writer_t *s, const uint8_t *data, size_t len)
+{
+    while (s->erased_to < s->write_offset + len) {
+        esp_err_t ret = esp_partition_erase_range(s->part, s->erased_to, FAKE_PARTITION_SECTOR_SIZE);
+        if (ret != ESP_OK) return ret;
+        s->erased_to += FAKE_PARTITION_SECTOR_SIZE;
+    }
+    esp_err_t ret = esp_partition_write(s->part, s->write_offset, data, len);
+    s->write_offset += len;
+    return ret;
+}
+
+/* Same loop as decode_to_flash() */
+static esp_err_t decode_block(gophr_hs_decoder_t *d, slot_writer_t *s, const uint8_t *data, size_t len)
+{
+    uint8_t out[256];
+    size_t n;
+    do {
+        size_t used;
+        n = gophr_hs_decode(d, data, len, &used, out, sizeof(out));
+        data += used;
+        len -= used;
+
+        size_t room = s->raw_size - s->write_offset;
+        if (n > room) n = room;
+        if (n) {
+            esp_err_t ret = slot_write(s, out, n);
+            if (ret != ESP_OK) return ret;
+        }
+    } while (len || n == sizeof(out));
+    return ESP_OK;
+}
+
+static void test_stream(int window_sz2, int lookahead_sz2, int blocks_per_wake)
+{
+    uint8_t *image = malloc(IMAGE_SIZE);
+    uint8_t *packed = malloc(IMAGE_SIZE * 2);
+    make_image(image, IMAGE_SIZE, 0x600d + (uint32_t)window_sz2);
+    size_t packed_len = hs_encode(image, IMAGE_SIZE, packed, window_sz2, lookahead_sz2);
+
+    slot_writer_t slot = {
+        .part = fake_partition_create(ESP_PARTITION_TYPE_APP, 0x10, "ota_0", SLOT_SIZE),
+        .raw_size = IMAGE_SIZE,
+    };
+
+    gophr_hs_decoder_t rtc;                 /* What survives deep sleep */
+    CHECK(gophr_hs_decoder_reset(&rtc, (uint8_t)window_sz2, (uint8_t)lookahead_sz2));
+
+    int wakes = 0;
+    for (size_t off = 0; off < packed_len; wakes++) {
+        /* Wake: pick the decoder up from RTC, take a few blocks, park it again */
+        gophr_hs_decoder_t d;
+        memcpy(&d, &rtc, sizeof(d));
+        for (int b = 0; b < blocks_per_wake && off < packed_len; b++) {
+            size_t n = packed_len - off < OTA_BLOCK ? packed_len - off : OTA_BLOCK;
+            CHECK_EQ(decode_block(&d, &slot, packed + off, n), ESP_OK);
+            off += n;
+        }
+        memcpy(&rtc, &d, sizeof(rtc));
+        memset(&d, 0xA5, sizeof(d));        /* RAM does not survive */
+    }
+
+    CHECK_EQ(slot.write_offset, IMAGE_SIZE);
+    CHECK(memcmp(fake_partition_data(), image, IMAGE_SIZE) == 0);
+
+    printf("w%d l%d: %d -> %zu bytes (%.0f%%), %zu blocks over %d wakes\n", window_sz2, lookahead_sz2,
+           IMAGE_SIZE, packed_len, 100.0 * packed_len / IMAGE_SIZE,
+           (packed_len + OTA_BLOCK - 1) / OTA_BLOCK, wakes);
+
+    fake_partition_destroy();
+    free(image);
+    free(packed);
+}
+
+/* Output buffer of one byte: a back-reference split across every call */
+static void test_tiny_output(void)
+{
+    static const uint8_t text[] = "abcabcabcabcabcabcabcabc-xyzxyzxyzxyz-abcabcabc";
+    uint8_t packed[128], out[sizeof(text)];
+    size_t packed_len = hs_encode(text, sizeof(text), packed, 8, 4);
+
+    gophr_hs_decoder_t d;
+    gophr_hs_decoder_reset(&d, 8, 4);
+    size_t in_off = 0, out_len = 0;
+    while (out_len < sizeof(text) && in_off <= packed_len) {
+        size_t used;
+        out_len += gophr_hs_decode(&d, packed + in_off, packed_len - in_off, &used, out + out_len, 1);
+        in_off += used;
+    }
+    CHECK_EQ(out_len, sizeof(text));
+    CHECK(memcmp(out, text, sizeof(text)) == 0);
+}
+
+static void test_reset_limits(void)
+{
+    gophr_hs_decoder_t d;
+    CHECK(!gophr_hs_decoder_reset(&d, 3, 2));
+    CHECK(!gophr_hs_decoder_reset(&d, GOPHR_HS_MAX_WINDOW_SZ2 + 1, 4));
+    CHECK(!gophr_hs_decoder_reset(&d, 8, 8));
+    CHECK(gophr_hs_decoder_reset(&d, 4, 3));
+    CHECK(gophr_hs_decoder_reset(&d, GOPHR_HS_MAX_WINDOW_SZ2, 5));
+}
+
+int main(void)
+{
+    test_reset_limits();
+    test_tiny_output();
+    test_stream(8, 4, 1);
+    test_stream(10, 5, 7);
+    test_stream(GOPHR_HS_MAX_WINDOW_SZ2, 4, 40);
+    TEST_EXIT();
+}
@@ -0,0 +1,202 @@
+/*
+ * Sliding-window median vs. the old copy + qsort() path.
+ *
+ * Checks that gophr_median_push() returns exactly what the old
+ * median_filter() returned for every sample of a set of moisture traces,
+ * then times both. Built once per window size (see CMakeLists.txt).
+ *
+ * Traces: pass recorded moisture voltages as files (one value per line,
+ * '#' comments allowed); without arguments, synthetic probe traces are used.
+ */
+
+#include "gophr_filter.h"
+#include "host_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TRACE_LEN       20000
+#define BENCH_REPEAT        50
+
+/* ---------- Old Path (baseline gophr_sensors.c) ---------- */
+
+static int float_compare(const void *a, const void *b)
+{
+    float fa = *(const float *)a;
+    float fb = *(const float *)b;
+    if (fa < fb) return -1;
+    if (fa > fb) return 1;
+    return 0;
+}
+
+static float median_filter(float *buf, int count)
+{
+    if (count == 0) return NAN;
+
+    float sorted[MEDIAN_FILTER_WINDOW];
+    memcpy(sorted, buf, count * sizeof(float));
+    qsort(sorted, count, sizeof(float), float_compare);
+
+    return sorted[count / 2];
+}
+
+typedef struct {
+    float buf[MEDIAN_FILTER_WINDOW];
+    int idx;
+    int count;
+} qsort_median_t;
+
+static float qsort_median_push(qsort_median_t *m, float v)
+{
+    m->buf[m->idx] = v;
+    m->idx = (m->idx + 1) % MEDIAN_FILTER_WINDOW;
+    if (m->count < MEDIAN_FILTER_WINDOW) m->count++;
+    return median_filter(m->buf, m->count);
+}
+
+/* ---------- Traces ---------- */
+
+typedef struct {
+    const char *name;
+    float v[MAX_TRACE_LEN];
+    int len;
+} trace_t;
+
+static trace_t s_traces[8];
+static int s_trace_count;
+
+/* Capacitive probe in soil: level, slow drift, ADC noise and the odd glitch */
+static void synth_trace(const char *name, float level, float drift_per_sample,
+                        float noise, int glitch_every, uint32_t seed)
+{
+    trace_t *t = &s_traces[s_trace_count++];
+    t->name = name;
+    t->len = MAX_TRACE_LEN;
+    for (int i = 0; i < t->len; i++) {
+        float v = level + drift_per_sample * i + noise * test_noise(&seed);
+        if (glitch_every && test_rand(&seed) % glitch_every == 0) {
+            v = (test_rand(&seed) & 1) ? 3.3f : 0.0f;
+        }
+        t->v[i] = v;
+    }
+}
+
+/* Watering events: step changes with a wetting curve back */
+static void synth_watering(uint32_t seed)
+{
+    trace_t *t = &s_traces[s_trace_count++];
+    t->name = "synthetic-watering";
+    t->len = MAX_TRACE_LEN;
+    float v = 2.2f;
+    for (int i = 0; i < t->len; i++) {
+        if (i % 2500 == 0) v = 1.3f;            /* Watered */
+        v += (2.2f - v) * 0.0008f;              /* Drying back */
+        t->v[i] = v + 0.01f * test_noise(&seed);
+    }
+}
+
+static int load_trace(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    trace_t *t = &s_traces[s_trace_count++];
+    t->name = path;
+    t->len = 0;
+    char line[128];
+    while (t->len < MAX_TRACE_LEN && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        char *end;
+        float v = strtof(line, &end);
+        if (end != line) t->v[t->len++] = v;
+    }
+    fclose(f);
+    return 0;
+}
+
+/* ---------- Tests ---------- */
+
+static void test_matches_qsort(const trace_t *t)
+{
+    gophr_median_t m;
+    qsort_median_t q = {0};
+    gophr_median_reset(&m);
+
+    int mismatches = 0;
+    for (int i = 0; i < t->len; i++) {
+        float a = gophr_median_push(&m, t->v[i]);
+        float b = qsort_median_push(&q, t->v[i]);
+        if (a != b && mismatches++ < 5) {
+            fprintf(stderr, "%s[%d]: median %f, qsort %f\n", t->name, i, a, b);
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+}
+
+/* Duplicates and ties: the eviction must drop exactly one copy */
+static void test_duplicates(void)
+{
+    gophr_median_t m;
+    qsort_median_t q = {0};
+    gophr_median_reset(&m);
+    uint32_t seed = 7;
+    for (int i = 0; i < 5000; i++) {
+        float v = (float)(test_rand(&seed) % 4) * 0.5f;
+        CHECK_EQ(gophr_median_push(&m, v) == qsort_median_push(&q, v), 1);
+    }
+}
+
+static void test_partial_window(void)
+{
+    gophr_median_t m;
+    gophr_median_reset(&m);
+    CHECK_NEAR(gophr_median_push(&m, 1.0f), 1.0f, 0);
+#if MEDIAN_FILTER_WINDOW >= 3
+    CHECK_NEAR(gophr_median_push(&m, 3.0f), 3.0f, 0);     /* Upper of two, as sorted[count / 2] */
+    CHECK_NEAR(gophr_median_push(&m, 2.0f), 2.0f, 0);
+#endif
+}
+
+static double bench(const trace_t *t, bool incremental)
+{
+    volatile float sink = 0;
+    double start = test_now_s();
+    for (int r = 0; r < BENCH_REPEAT; r++) {
+        gophr_median_t m;
+        qsort_median_t q = {0};
+        gophr_median_reset(&m);
+        for (int i = 0; i < t->len; i++) {
+            sink = incremental ? gophr_median_push(&m, t->v[i]) : qsort_median_push(&q, t->v[i]);
+        }
+    }
+    (void)sink;
+    return (test_now_s() - start) * 1e9 / ((double)t->len * BENCH_REPEAT);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc && s_trace_count < (int)(sizeof(s_traces) / sizeof(s_traces[0])); i++) {
+        if (load_trace(argv[i]) != 0) return 1;
+    }
+    if (s_trace_count == 0) {
+        synth_trace("synthetic-stable", 1.65f, 0.0f, 0.015f, 0, 1);
+        synth_trace("synthetic-noisy", 1.80f, 0.0f, 0.060f, 200, 2);
+        synth_trace("synthetic-drying", 1.30f, 0.00004f, 0.010f, 1000, 3);
+        synth_watering(4);
+    }
+
+    test_partial_window();
+    test_duplicates();
+
+    printf("window %d: ns/sample  incremental  qsort\n", MEDIAN_FILTER_WINDOW);
+    for (int i = 0; i < s_trace_count; i++) {
+        test_matches_qsort(&s_traces[i]);
+        double inc = bench(&s_traces[i], true);
+        double qs = bench(&s_traces[i], false);
+        printf("  %-22s %10.1f %7.1f  (%.1fx)\n", s_traces[i].name, inc, qs, qs / inc);
+    }
+
+    TEST_EXIT();
+}
@@ -0,0 +1,98 @@
+/*
+ * Seqlock stress test: one writer publishes as fast as it can while
+ * several reader threads copy snapshots. Every field of a published value
+ * carries the same generation number, so a torn copy shows up as mixed
+ * generations; readers also check that generations never go backwards.
+ */
+
+#include "gophr_seqlock.h"
+#include "host_test.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define READERS         4
+#define WRITES          2000000
+#define FIELDS          12          /* sensor_readings_t is 12 words */
+
+typedef struct {
+    uint32_t gen[FIELDS];
+} payload_t;
+
+static payload_t s_copies[2];
+static gophr_seqlock_t s_lock;
+static atomic_bool s_done;
+
+typedef struct {
+    uint64_t reads;
+    uint64_t torn;
+    uint64_t backwards;
+    uint32_t last;
+} reader_stats_t;
+
+static void *reader(void *arg)
+{
+    reader_stats_t *st = arg;
+    payload_t p;
+    while (!atomic_load_explicit(&s_done, memory_order_relaxed)) {
+        gophr_seqlock_read(&s_lock, s_copies, &p, sizeof(p));
+        for (int i = 1; i < FIELDS; i++) {
+            if (p.gen[i] != p.gen[0]) {
+                st->torn++;
+                break;
+            }
+        }
+        if (p.gen[0] < st->last) st->backwards++;
+        st->last = p.gen[0];
+        st->reads++;
+    }
+    return NULL;
+}
+
+static void *writer(void *arg)
+{
+    (void)arg;
+    payload_t p;
+    for (uint32_t g = 1; g <= WRITES; g++) {
+        for (int i = 0; i < FIELDS; i++) p.gen[i] = g;
+        gophr_seqlock_write(&s_lock, s_copies, &p, sizeof(p));
+    }
+    atomic_store(&s_done, true);
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t readers[READERS], w;
+    reader_stats_t stats[READERS] = {0};
+
+    for (int i = 0; i < READERS; i++) {
+        pthread_create(&readers[i], NULL, reader, &stats[i]);
+    }
+    double start = test_now_s();
+    pthread_create(&w, NULL, writer, NULL);
+    pthread_join(w, NULL);
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    double elapsed = test_now_s() - start;
+
+    uint64_t reads = 0;
+    for (int i = 0; i < READERS; i++) {
+        reads += stats[i].reads;
+        CHECK_EQ(stats[i].torn, 0);
+        CHECK_EQ(stats[i].backwards, 0);
+        CHECK(stats[i].reads > 0);
+    }
+
+    /* The latest value is what a late reader sees */
+    payload_t p;
+    gophr_seqlock_read(&s_lock, s_copies, &p, sizeof(p));
+    CHECK_EQ(p.gen[0], WRITES);
+    CHECK_EQ(p.gen[FIELDS - 1], WRITES);
+
+    printf("%d writes, %llu reads by %d readers in %.2fs\n", WRITES,
+           (unsigned long long)reads, READERS, elapsed);
+    TEST_EXIT();
+}
@@ -0,0 +1,199 @@
+/*
+ * Settling detector replay.
+ *
+ * Replays power-up curves through gophr_settle_push() at the rate
+ * gophr_sensors_wait_settled() samples (SETTLE_SAMPLE_MS), with its 30 s
+ * timeout, and checks when (and whether) each curve is declared settled.
+ *
+ * Captured curves can be passed as files of "time_ms,voltage" lines
+ * ('#' comments allowed); they are replayed and reported, not checked.
+ */
+
+#include "gophr_settle.h"
+#include "host_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_MS       250         /* SETTLE_SAMPLE_MS */
+#define TIMEOUT_MS      30000       /* SETTLE_TIMEOUT_MS */
+#define MAX_POINTS      4096
+
+typedef float (*curve_fn_t)(uint32_t t_ms, uint32_t *seed);
+
+typedef struct {
+    bool settled;
+    uint32_t at_ms;
+    float voltage;
+} replay_result_t;
+
+/* Feed a curve until settled or timeout, like gophr_sensors_wait_settled() */
+static replay_result_t replay(curve_fn_t curve, uint32_t seed)
+{
+    const gophr_settle_cfg_t cfg = GOPHR_SETTLE_CFG_DEFAULT();
+    gophr_settle_t s;
+    gophr_settle_reset(&s);
+
+    replay_result_t r = {0};
+    for (uint32_t t = 0; t < TIMEOUT_MS; t += SAMPLE_MS) {
+        float v = curve(t, &seed);
+        if (gophr_settle_push(&s, &cfg, t, v)) {
+            r.settled = true;
+            r.at_ms = t;
+            r.voltage = v;
+            break;
+        }
+    }
+    return r;
+}
+
+/* ---------- Curves ---------- */
+
+/* RC charge towards `final` with time constant tau_s, plus ADC noise */
+static float rc(uint32_t t_ms, float final, float tau_s, float noise, uint32_t *seed)
+{
+    return final * (1.0f - expf(-(float)t_ms / 1000.0f / tau_s)) + noise * test_noise(seed);
+}
+
+static float curve_flat(uint32_t t, uint32_t *seed) { (void)t; (void)seed; return 1.50f; }
+static float curve_fast(uint32_t t, uint32_t *seed) { return rc(t, 1.60f, 0.4f, 0.003f, seed); }
+static float curve_slow(uint32_t t, uint32_t *seed) { return rc(t, 1.80f, 4.0f, 0.003f, seed); }
+static float curve_dry_air(uint32_t t, uint32_t *seed) { return rc(t, 0.40f, 0.3f, 0.002f, seed); }
+static float curve_noisy(uint32_t t, uint32_t *seed) { return rc(t, 1.60f, 0.4f, 0.050f, seed); }
+
+/* Probe that drifts for the whole window (e.g. soil still soaking up water) */
+static float curve_drift(uint32_t t, uint32_t *seed)
+{
+    return 1.2f + 0.05f * (float)t / 1000.0f + 0.002f * test_noise(seed);
+}
+
+/* Underdamped power-up: overshoot that rings down */
+static float curve_ringing(uint32_t t, uint32_t *seed)
+{
+    float ts = (float)t / 1000.0f;
+    return 1.6f + 0.4f * expf(-ts / 1.5f) * cosf(ts * 3.0f) + 0.002f * test_noise(seed);
+}
+
+/* Flat but every third sample dropped by the ADC */
+static float curve_gaps(uint32_t t, uint32_t *seed)
+{
+    (void)seed;
+    return (t / SAMPLE_MS) % 3 == 2 ? NAN : 1.40f;
+}
+
+/* ---------- Tests ---------- */
+
+static void test_flat_settles_when_window_full(void)
+{
+    replay_result_t r = replay(curve_flat, 1);
+    CHECK(r.settled);
+    CHECK_EQ(r.at_ms, (GOPHR_SETTLE_WINDOW - 1) * SAMPLE_MS);
+}
+
+static void test_fast_probe(void)
+{
+    replay_result_t r = replay(curve_fast, 2);
+    CHECK(r.settled);
+    CHECK(r.at_ms <= 5000);                 /* vs. the old fixed 30 s */
+    CHECK_NEAR(r.voltage, 1.60f, 0.02);
+}
+
+static void test_slow_probe(void)
+{
+    replay_result_t r = replay(curve_slow, 3);
+    CHECK(r.settled);
+    CHECK(r.at_ms > 5000);
+    CHECK(r.at_ms < TIMEOUT_MS);
+    CHECK_NEAR(r.voltage, 1.80f, 0.06);     /* Slope limit x tau, plus noise */
+}
+
+static void test_below_min_voltage(void)
+{
+    CHECK(!replay(curve_dry_air, 4).settled);
+}
+
+static void test_noise_never_settles(void)
+{
+    CHECK(!replay(curve_noisy, 5).settled);
+}
+
+static void test_drift_never_settles(void)
+{
+    CHECK(!replay(curve_drift, 6).settled);
+}
+
+static void test_ringing_waits_for_decay(void)
+{
+    replay_result_t r = replay(curve_ringing, 7);
+    CHECK(r.settled);
+    CHECK(r.at_ms > 4000);
+    CHECK_NEAR(r.voltage, 1.6f, 0.02);
+}
+
+static void test_nan_samples_ignored(void)
+{
+    replay_result_t r = replay(curve_gaps, 8);
+    CHECK(r.settled);
+    /* Window fills from valid samples only: two of every three */
+    CHECK_EQ(r.at_ms, ((GOPHR_SETTLE_WINDOW - 1) / 2 * 3 + (GOPHR_SETTLE_WINDOW - 1) % 2) * SAMPLE_MS);
+}
+
+static void test_stays_settled_until_reset(void)
+{
+    const gophr_settle_cfg_t cfg = GOPHR_SETTLE_CFG_DEFAULT();
+    gophr_settle_t s;
+    gophr_settle_reset(&s);
+    for (int i = 0; i < GOPHR_SETTLE_WINDOW; i++) {
+        gophr_settle_push(&s, &cfg, (uint32_t)i * SAMPLE_MS, 1.5f);
+    }
+    CHECK(gophr_settle_push(&s, &cfg, 10000, 0.0f));
+    gophr_settle_reset(&s);
+    CHECK(!gophr_settle_push(&s, &cfg, 0, 1.5f));
+}
+
+/* ---------- Captured Curves ---------- */
+
+static void replay_file(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        s_test_failures++;
+        return;
+    }
+
+    const gophr_settle_cfg_t cfg = GOPHR_SETTLE_CFG_DEFAULT();
+    gophr_settle_t s;
+    gophr_settle_reset(&s);
+
+    char line[128];
+    unsigned long t;
+    float v;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || sscanf(line, "%lu,%f", &t, &v) != 2) continue;
+        if (gophr_settle_push(&s, &cfg, (uint32_t)t, v)) {
+            printf("%s: settled at %lums (%.3fV)\n", path, t, v);
+            break;
+        }
+    }
+    if (!s.ready) printf("%s: never settled\n", path);
+    fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+    test_flat_settles_when_window_full();
+    test_fast_probe();
+    test_slow_probe();
+    test_below_min_voltage();
+    test_noise_never_settles();
+    test_drift_never_settles();
+    test_ringing_waits_for_decay();
+    test_nan_samples_ignored();
+    test_stays_settled_until_reset();
+
+    for (int i = 1; i < argc; i++) {
+        replay_file(argv[i]);
+    }
+    TEST_EXIT();
+}
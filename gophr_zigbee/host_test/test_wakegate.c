@@ -0,0 +1,171 @@
+/*
+ * Wake gate test: the decision rules on hand-made sequences, then a month
+ * of 30-minute timer wakes over simulated soil (slow dry-down, sensor
+ * noise, a watering every few days). Counts how many wakes bring the radio
+ * up and checks the network never lags the soil by more than the delta.
+ */
+
+#include "gophr_wakegate.h"
+#include "host_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WAKE_MIN        30
+#define MONTH_WAKES     (30 * 24 * 60 / WAKE_MIN)
+
+static const gophr_wakegate_cfg_t s_cfg = {
+    .delta = GOPHR_WAKEGATE_DELTA,
+    .max_skips = GOPHR_WAKEGATE_MAX_INTERVAL_MIN / WAKE_MIN - 1,
+};
+
+static void fill(uint16_t m[GOPHR_WAKEGATE_CHANNELS], uint16_t a, uint16_t b, uint16_t c)
+{
+    m[0] = a;
+    m[1] = b;
+    m[2] = c;
+}
+
+/* No valid state (cold boot, power loss): report until something was delivered */
+static void test_invalid_state(void)
+{
+    gophr_wakegate_t g;
+    memset(&g, 0x5A, sizeof(g));
+    uint16_t m[GOPHR_WAKEGATE_CHANNELS];
+    fill(m, 4000, 4000, 4000);
+
+    CHECK(gophr_wakegate_sample(&g, &s_cfg, m));
+    CHECK(gophr_wakegate_sample(&g, &s_cfg, m));
+    gophr_wakegate_reported(&g, m);
+    CHECK(!gophr_wakegate_sample(&g, &s_cfg, m));
+}
+
+static void test_delta(void)
+{
+    gophr_wakegate_t g;
+    gophr_wakegate_reset(&g);
+    uint16_t m[GOPHR_WAKEGATE_CHANNELS];
+    fill(m, 4000, 5000, 6000);
+    gophr_wakegate_reported(&g, m);
+
+    /* Exactly delta on every channel is not a move */
+    fill(m, 4000 + GOPHR_WAKEGATE_DELTA, 5000 - GOPHR_WAKEGATE_DELTA, 6000);
+    CHECK(!gophr_wakegate_sample(&g, &s_cfg, m));
+
+    /* One channel past it is, in either direction */
+    fill(m, 4000, 5000, 6000 - GOPHR_WAKEGATE_DELTA - 1);
+    CHECK(gophr_wakegate_sample(&g, &s_cfg, m));
+    fill(m, 4000, 5000 + GOPHR_WAKEGATE_DELTA + 1, 6000);
+    CHECK(gophr_wakegate_sample(&g, &s_cfg, m));
+}
+
+/* Compared against the last report, not the last sample: slow drift adds up */
+static void test_drift(void)
+{
+    gophr_wakegate_t g;
+    gophr_wakegate_reset(&g);
+    uint16_t m[GOPHR_WAKEGATE_CHANNELS];
+    fill(m, 4000, 4000, 4000);
+    gophr_wakegate_reported(&g, m);
+
+    int wakes = 0;
+    do {
+        m[1] -= 50;
+        wakes++;
+    } while (!gophr_wakegate_sample(&g, &s_cfg, m));
+    CHECK_EQ(wakes, GOPHR_WAKEGATE_DELTA / 50 + 1);
+}
+
+static void test_max_skips(void)
+{
+    gophr_wakegate_t g;
+    gophr_wakegate_reset(&g);
+    gophr_wakegate_cfg_t cfg = {.delta = GOPHR_WAKEGATE_DELTA, .max_skips = 3};
+    uint16_t m[GOPHR_WAKEGATE_CHANNELS];
+    fill(m, 4000, 4000, 4000);
+    gophr_wakegate_reported(&g, m);
+
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < cfg.max_skips; i++) {
+            CHECK(!gophr_wakegate_sample(&g, &cfg, m));
+        }
+        CHECK(gophr_wakegate_sample(&g, &cfg, m));
+        gophr_wakegate_reported(&g, m);
+    }
+
+    /* No skipping at all */
+    cfg.max_skips = 0;
+    CHECK(gophr_wakegate_sample(&g, &cfg, m));
+}
+
+/* A month of wakes; returns how many reported */
+static int simulate_month(uint32_t seed, float dry_per_hour, int water_every_h, float noise)
+{
+    gophr_wakegate_t g;
+    gophr_wakegate_reset(&g);
+
+    float soil[GOPHR_WAKEGATE_CHANNELS] = {6000, 5500, 5000};
+    uint16_t reported[GOPHR_WAKEGATE_CHANNELS] = {0};
+    int reports = 0, since_report = 0, worst_gap = 0;
+
+    for (int w = 0; w < MONTH_WAKES; w++) {
+        int minute = w * WAKE_MIN;
+        bool watered = water_every_h && minute > 0 && minute % (water_every_h * 60) == 0;
+
+        uint16_t m[GOPHR_WAKEGATE_CHANNELS];
+        for (int i = 0; i < GOPHR_WAKEGATE_CHANNELS; i++) {
+            soil[i] -= dry_per_hour * WAKE_MIN / 60.0f;
+            if (watered) soil[i] = 6000 - 500 * i;
+            if (soil[i] < 1000) soil[i] = 1000;
+            m[i] = (uint16_t)(soil[i] + noise * test_noise(&seed));
+        }
+
+        if (gophr_wakegate_sample(&g, &s_cfg, m)) {
+            gophr_wakegate_reported(&g, m);
+            memcpy(reported, m, sizeof(reported));
+            reports++;
+            since_report = 0;
+        } else {
+            /* Skipped: the network is still within delta of this sample */
+            for (int i = 0; i < GOPHR_WAKEGATE_CHANNELS; i++) {
+                CHECK(abs((int)m[i] - (int)reported[i]) <= GOPHR_WAKEGATE_DELTA);
+            }
+            CHECK(!watered);
+            since_report++;
+            if (since_report > worst_gap) worst_gap = since_report;
+        }
+    }
+    CHECK(worst_gap <= s_cfg.max_skips);
+    return reports;
+}
+
+int main(void)
+{
+    test_invalid_state();
+    test_delta();
+    test_drift();
+    test_max_skips();
+
+    static const struct {
+        const char *name;
+        float dry_per_hour;     /* 0.01% per hour */
+        int water_every_h;
+        float noise;
+    } soils[] = {
+        {"stable", 0, 0, 30},
+        {"slow dry-down", 5, 96, 40},
+        {"fast dry-down", 40, 48, 40},
+        {"noisy probe", 5, 96, 150},
+    };
+    for (size_t i = 0; i < sizeof(soils) / sizeof(soils[0]); i++) {
+        int reports = simulate_month(0xbeef + (uint32_t)i, soils[i].dry_per_hour,
+                                     soils[i].water_every_h, soils[i].noise);
+        printf("%-14s %4d of %d wakes reported (%.1fx fewer radio wakes)\n", soils[i].name,
+               reports, MONTH_WAKES, (double)MONTH_WAKES / reports);
+        CHECK(reports < MONTH_WAKES);
+    }
+
+    /* Stable soil only reports on the max interval */
+    CHECK_EQ(simulate_month(1, 0, 0, 30), (MONTH_WAKES + s_cfg.max_skips) / (s_cfg.max_skips + 1));
+    TEST_EXIT();
+}
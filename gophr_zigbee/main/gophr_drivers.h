@@ -29,13 +29,42 @@
 
 /* ---------- ADC ---------- */
 
+/* ADC1 channels 0-4 (GPIO0-4 on the C6), scanned together in one DMA burst */
+#define GOPHR_ADC_CHANNEL_COUNT     5
+
+/* Conversions averaged per channel in each snapshot */
+#ifndef GOPHR_ADC_OVERSAMPLE
+#define GOPHR_ADC_OVERSAMPLE        16
+#endif
+
+/* Scan rate across all channels (Hz) */
+#ifndef GOPHR_ADC_SAMPLE_FREQ_HZ
+#define GOPHR_ADC_SAMPLE_FREQ_HZ    20000
+#endif
+
+/* One averaged reading of every ADC channel, indexed by GPIO number */
+typedef struct {
+    float voltage[GOPHR_ADC_CHANNEL_COUNT];  /* Volts, NAN if the channel got no samples */
+} gophr_adc_snapshot_t;
+
 esp_err_t gophr_adc_init(void);
-int gophr_adc_read_raw(int gpio_num);
-float gophr_adc_read_voltage(int gpio_num);
+esp_err_t gophr_adc_read_snapshot(gophr_adc_snapshot_t *snap);
 
 /* ---------- I2C / AHT20 ---------- */
 
 esp_err_t gophr_i2c_init(void);
+
+/* Start a conversion and return immediately (result ready ~80ms later) */
+esp_err_t gophr_aht20_trigger(void);
+
+/*
+ * Collect the pending conversion (triggers one if none is pending). Sleeps
+ * only for whatever is left of the conversion time, retries on the busy bit
+ * and checks the CRC byte.
+ */
+esp_err_t gophr_aht20_collect(float *temperature, float *humidity);
+
+/* Blocking trigger + collect */
 esp_err_t gophr_aht20_read(float *temperature, float *humidity);
 
 /* ---------- GPIO Power Control ---------- */
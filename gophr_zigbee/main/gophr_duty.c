@@ -0,0 +1,67 @@
+#include "gophr_duty.h"
+
+/* Linear from (x0, y0) to (x1, y1), clamped to the ends; x0 != x1 */
+static int32_t lerp(int32_t x, int32_t x0, int32_t x1, int32_t y0, int32_t y1)
+{
+    if (x0 > x1) {
+        return lerp(x, x1, x0, y1, y0);
+    }
+    if (x <= x0) return y0;
+    if (x >= x1) return y1;
+    return y0 + (y1 - y0) * (x - x0) / (x1 - x0);
+}
+
+static int clamp(int v, int lo, int hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+gophr_duty_t gophr_duty_policy(const gophr_duty_state_t *state, const gophr_duty_settings_t *settings)
+{
+    gophr_duty_t out = {
+        .sleep_min = settings->sleep_min,
+        .min_awake_min = settings->min_awake_min,
+    };
+#if GOPHR_DUTY_ADAPTIVE
+    int soc = clamp((int)(state->battery_percent + 0.5f), 0, 100);
+
+    /* Step the charging ramp towards where it should be */
+    int target = state->solar_charging && soc >= GOPHR_DUTY_SOC_FULL ? 1000 : 0;
+    int ramp = clamp(state->tighten_pm, 0, 1000);
+    ramp = clamp(target, ramp - GOPHR_DUTY_TIGHTEN_STEP, ramp + GOPHR_DUTY_TIGHTEN_STEP);
+    out.tighten_pm = ramp;
+
+    /* Interval scale in per mille of the nominal interval */
+    int32_t scale;
+    if (soc >= GOPHR_DUTY_SOC_FULL) {
+        int32_t tight = lerp(soc, GOPHR_DUTY_SOC_FULL, 100, 1000, 1000 / GOPHR_DUTY_MAX_TIGHTEN);
+        scale = 1000 - (1000 - tight) * ramp / 1000;
+    } else if (soc >= GOPHR_DUTY_SOC_LOW) {
+        scale = lerp(soc, GOPHR_DUTY_SOC_OK, GOPHR_DUTY_SOC_LOW, 1000, 4000);
+    } else {
+        scale = lerp(soc, GOPHR_DUTY_SOC_LOW, GOPHR_DUTY_SOC_EMPTY, 4000, GOPHR_DUTY_MAX_STRETCH * 1000);
+    }
+
+    /* A long dark spell means no recharge is coming soon: save up to 2x more */
+    if (!state->solar_charging && soc < GOPHR_DUTY_DARK_SOC) {
+        int32_t dark_h = (int32_t)(state->dark_min / 60);
+        scale = scale * lerp(dark_h, 0, GOPHR_DUTY_DARK_HOURS, 1000, 2000) / 1000;
+    }
+
+    /* The user bounds narrow the policy's own range, they never widen it */
+    int nominal = settings->sleep_min;
+    int lo = nominal / GOPHR_DUTY_MAX_TIGHTEN;
+    int hi = nominal * GOPHR_DUTY_MAX_STRETCH;
+    if (settings->min_interval_min > lo) lo = settings->min_interval_min;
+    if (settings->max_interval_min > 0 && settings->max_interval_min < hi) hi = settings->max_interval_min;
+    hi = clamp(hi, GOPHR_DUTY_SLEEP_MIN_MIN, GOPHR_DUTY_SLEEP_MAX_MIN);
+    lo = clamp(lo, GOPHR_DUTY_SLEEP_MIN_MIN, hi);
+    out.sleep_min = clamp((int)(((int64_t)nominal * scale + 500) / 1000), lo, hi);
+
+    int32_t awake_scale = lerp(soc, GOPHR_DUTY_AWAKE_SOC_NONE, GOPHR_DUTY_AWAKE_SOC_FULL, 0, 1000);
+    out.min_awake_min = (int)(settings->min_awake_min * awake_scale / 1000);
+#else
+    (void)state;
+#endif
+    return out;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Energy-aware duty cycle. A pure function of the power state and the user
+ * settings, so it can be run on the host over simulated weather.
+ *
+ * The user sleep duration is the nominal interval. It is stretched as the
+ * battery drains (up to GOPHR_DUTY_MAX_STRETCH times at GOPHR_DUTY_SOC_EMPTY)
+ * and further while no solar has been seen for a while. It is tightened
+ * (down to 1/GOPHR_DUTY_MAX_TIGHTEN) when the battery is full and charging.
+ * That tightening is ramped in and out by GOPHR_DUTY_TIGHTEN_STEP per sleep,
+ * so a charger flickering on and off at full charge moves the interval by
+ * one step at most instead of jumping the whole factor each time.
+ * The user min/max interval settings, when set, narrow that range: the
+ * result never leaves them, nor the range the sleep duration setter
+ * accepts. The user min awake window is cut towards 0 on a low battery and
+ * is never raised.
+ *
+ * Every step is linear in the battery level, so small changes in the
+ * reading give small changes in the interval.
+ */
+
+#ifndef GOPHR_DUTY_ADAPTIVE
+#define GOPHR_DUTY_ADAPTIVE         1       /* 0 = always use the user settings */
+#endif
+
+#define GOPHR_DUTY_MAX_STRETCH      8       /* Longest interval, x nominal */
+#define GOPHR_DUTY_MAX_TIGHTEN      2       /* Shortest interval, nominal / N */
+#define GOPHR_DUTY_SLEEP_MIN_MIN    1       /* Limits of gophr_sleep_set_duration() */
+#define GOPHR_DUTY_SLEEP_MAX_MIN    1440
+
+#define GOPHR_DUTY_SOC_FULL         90      /* %, tighten above this while charging */
+#define GOPHR_DUTY_SOC_OK           60      /* %, nominal interval down to here */
+#define GOPHR_DUTY_SOC_LOW          20      /* %, 4x nominal here */
+#define GOPHR_DUTY_SOC_EMPTY        5       /* %, GOPHR_DUTY_MAX_STRETCH x nominal */
+#define GOPHR_DUTY_AWAKE_SOC_FULL   40      /* %, full min awake window down to here */
+#define GOPHR_DUTY_AWAKE_SOC_NONE   15      /* %, no min awake window below this */
+#define GOPHR_DUTY_DARK_SOC         80      /* %, missing solar only matters below this */
+#define GOPHR_DUTY_DARK_HOURS       72      /* Hours without solar for 2x */
+
+#ifndef GOPHR_DUTY_TIGHTEN_STEP
+#define GOPHR_DUTY_TIGHTEN_STEP     250     /* Per mille of the tightening gained or lost per sleep */
+#endif
+
+typedef struct {
+    float battery_percent;
+    bool solar_charging;
+    uint32_t dark_min;          /* Minutes since solar was last seen */
+    int tighten_pm;             /* Ramp from the last result, 0 after a cold boot */
+} gophr_duty_state_t;
+
+typedef struct {
+    int sleep_min;              /* User sleep duration (nominal) */
+    int min_awake_min;          /* User min awake window */
+    int min_interval_min;       /* User bounds on the interval, 0 = none */
+    int max_interval_min;
+} gophr_duty_settings_t;
+
+typedef struct {
+    int sleep_min;
+    int min_awake_min;
+    int tighten_pm;             /* Charging ramp, 0..1000; feed back in next time */
+} gophr_duty_t;
+
+gophr_duty_t gophr_duty_policy(const gophr_duty_state_t *state, const gophr_duty_settings_t *settings);
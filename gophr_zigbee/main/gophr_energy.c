@@ -0,0 +1,204 @@
+#include "gophr_energy.h"
+
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+static const char *TAG = "gophr_energy";
+
+#define ENERGY_RTC_MAGIC    0x47454E31  /* "GEN1" */
+#define UA_MS_PER_UAH       3600000ULL
+
+static const uint32_t s_default_currents[GOPHR_LOAD_COUNT] = {
+    [GOPHR_LOAD_SENSOR_RAIL] = GOPHR_ENERGY_SENSOR_RAIL_UA,
+    [GOPHR_LOAD_AHT20_RAIL]  = GOPHR_ENERGY_AHT20_RAIL_UA,
+    [GOPHR_LOAD_LED_RAIL]    = GOPHR_ENERGY_LED_RAIL_UA,
+    [GOPHR_LOAD_RADIO]       = GOPHR_ENERGY_RADIO_UA,
+    [GOPHR_LOAD_CPU_ACTIVE]  = GOPHR_ENERGY_CPU_ACTIVE_UA,
+    [GOPHR_LOAD_LIGHT_SLEEP] = GOPHR_ENERGY_LIGHT_SLEEP_UA,
+    [GOPHR_LOAD_DEEP_SLEEP]  = GOPHR_ENERGY_DEEP_SLEEP_UA,
+};
+
+static const char *const s_load_names[GOPHR_LOAD_COUNT] = {
+    [GOPHR_LOAD_SENSOR_RAIL] = "sensor",
+    [GOPHR_LOAD_AHT20_RAIL]  = "aht20",
+    [GOPHR_LOAD_LED_RAIL]    = "led",
+    [GOPHR_LOAD_RADIO]       = "radio",
+    [GOPHR_LOAD_CPU_ACTIVE]  = "cpu",
+    [GOPHR_LOAD_LIGHT_SLEEP] = "light",
+    [GOPHR_LOAD_DEEP_SLEEP]  = "deep",
+};
+
+/* Survives deep sleep */
+static RTC_DATA_ATTR uint32_t s_rtc_magic;
+static RTC_DATA_ATTR gophr_energy_summary_t s_summary;
+static RTC_DATA_ATTR uint64_t s_day_ua_ms;          /* Charge of the current 24h period */
+static RTC_DATA_ATTR uint32_t s_day_ms;             /* Time covered by it */
+static RTC_DATA_ATTR int64_t s_deep_entry_us;       /* gettimeofday() at deep sleep, 0 = none */
+
+/* Current cycle */
+static uint32_t s_currents[GOPHR_LOAD_COUNT];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_cycle_start_us;
+static int64_t s_on_us[GOPHR_LOAD_COUNT];           /* Accumulated on time (switched loads) */
+static int64_t s_on_since_us[GOPHR_LOAD_COUNT];
+static bool s_on[GOPHR_LOAD_COUNT];
+static int64_t s_light_us;                          /* Light sleep this cycle */
+static int64_t s_light_radio_us;                    /* ... of which with the radio on */
+static uint32_t s_deep_ms;                          /* Deep sleep that opened this cycle */
+
+static int64_t wall_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* ---------- Light Sleep Accounting ---------- */
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+/* Runs in the idle task with interrupts off, right after each light sleep */
+static IRAM_ATTR esp_err_t light_sleep_exit_cb(int64_t slept_us, void *arg)
+{
+    portENTER_CRITICAL_SAFE(&s_lock);
+    s_light_us += slept_us;
+    if (s_on[GOPHR_LOAD_RADIO]) {
+        s_light_radio_us += slept_us;
+    }
+    portEXIT_CRITICAL_SAFE(&s_lock);
+    return ESP_OK;
+}
+#endif
+
+/* ---------- Init ---------- */
+
+esp_err_t gophr_energy_init(const uint32_t *currents_ua)
+{
+    memcpy(s_currents, currents_ua ? currents_ua : s_default_currents, sizeof(s_currents));
+
+    if (s_rtc_magic != ENERGY_RTC_MAGIC) {
+        memset(&s_summary, 0, sizeof(s_summary));
+        s_day_ua_ms = 0;
+        s_day_ms = 0;
+        s_deep_entry_us = 0;
+        s_rtc_magic = ENERGY_RTC_MAGIC;
+    }
+
+    /* Wall time asleep, less the part of this boot esp_timer already counts */
+    s_deep_ms = 0;
+    if (s_deep_entry_us) {
+        int64_t asleep_us = wall_us() - s_deep_entry_us - esp_timer_get_time();
+        if (asleep_us > 0) s_deep_ms = (uint32_t)(asleep_us / 1000);
+        s_deep_entry_us = 0;
+    }
+    s_cycle_start_us = 0;
+    memset(s_on_us, 0, sizeof(s_on_us));
+    memset(s_on, 0, sizeof(s_on));
+    s_light_us = 0;
+    s_light_radio_us = 0;
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    esp_pm_sleep_cbs_register_config_t cbs = {
+        .exit_cb = light_sleep_exit_cb,
+    };
+    esp_err_t ret = esp_pm_light_sleep_register_cbs(&cbs);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Light sleep callbacks not registered: %s", esp_err_to_name(ret));
+    }
+#else
+    ESP_LOGW(TAG, "No PM light sleep callbacks, light sleep counts as CPU active");
+#endif
+    return ESP_OK;
+}
+
+/* ---------- Loads ---------- */
+
+void gophr_energy_load(gophr_load_t load, bool on)
+{
+    if (load >= GOPHR_LOAD_COUNT) return;
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    if (on && !s_on[load]) {
+        s_on_since_us[load] = now;
+    } else if (!on && s_on[load]) {
+        s_on_us[load] += now - s_on_since_us[load];
+    }
+    s_on[load] = on;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/* ---------- Cycle Close ---------- */
+
+void gophr_energy_close_cycle(bool deep)
+{
+    uint32_t ms[GOPHR_LOAD_COUNT] = {0};
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    for (int l = 0; l < GOPHR_LOAD_COUNT; l++) {
+        if (s_on[l]) {
+            s_on_us[l] += now - s_on_since_us[l];
+            s_on_since_us[l] = now;
+        }
+        ms[l] = (uint32_t)(s_on_us[l] / 1000);
+        s_on_us[l] = 0;
+    }
+    int64_t light_us = s_light_us;
+    int64_t light_radio_us = s_light_radio_us;
+    s_light_us = 0;
+    s_light_radio_us = 0;
+    portEXIT_CRITICAL(&s_lock);
+
+    int64_t awake_us = now - s_cycle_start_us;
+    ms[GOPHR_LOAD_RADIO] = ms[GOPHR_LOAD_RADIO] > light_radio_us / 1000 ?
+                           ms[GOPHR_LOAD_RADIO] - (uint32_t)(light_radio_us / 1000) : 0;
+    ms[GOPHR_LOAD_CPU_ACTIVE] = (uint32_t)((awake_us - light_us) / 1000);
+    ms[GOPHR_LOAD_LIGHT_SLEEP] = (uint32_t)(light_us / 1000);
+    ms[GOPHR_LOAD_DEEP_SLEEP] = s_deep_ms;
+
+    uint64_t ua_ms = 0;
+    for (int l = 0; l < GOPHR_LOAD_COUNT; l++) {
+        ua_ms += (uint64_t)ms[l] * s_currents[l];
+    }
+
+    /* Rolling 24h window over awake and asleep time */
+    s_day_ua_ms += ua_ms;
+    s_day_ms += (uint32_t)(awake_us / 1000) + s_deep_ms;
+    if (s_day_ms >= GOPHR_ENERGY_DAY_MS) {
+        s_summary.day_uah = (uint32_t)(s_day_ua_ms / UA_MS_PER_UAH);
+        s_day_ua_ms = 0;
+        s_day_ms = 0;
+    }
+
+    memcpy(s_summary.load_ms, ms, sizeof(ms));
+    s_summary.cycle_uah = (uint32_t)((ua_ms + UA_MS_PER_UAH / 2) / UA_MS_PER_UAH);
+    s_summary.today_uah = (uint32_t)(s_day_ua_ms / UA_MS_PER_UAH);
+    s_summary.cycles++;
+
+    char line[256];
+    int len = snprintf(line, sizeof(line), "GENERGY v1 cycle=%lu uah=%lu today=%lu day=%lu",
+                       (unsigned long)s_summary.cycles, (unsigned long)s_summary.cycle_uah,
+                       (unsigned long)s_summary.today_uah, (unsigned long)s_summary.day_uah);
+    for (int l = 0; l < GOPHR_LOAD_COUNT && len < (int)sizeof(line); l++) {
+        len += snprintf(line + len, sizeof(line) - len, " %s=%lu", s_load_names[l], (unsigned long)ms[l]);
+    }
+    ESP_LOGI(TAG, "%s", line);
+
+    /* Next cycle: a light sleep stays in it, a deep sleep is measured on wake */
+    s_cycle_start_us = now;
+    s_deep_ms = 0;
+    s_deep_entry_us = deep ? wall_us() : 0;
+}
+
+void gophr_energy_get(gophr_energy_summary_t *out)
+{
+    *out = s_summary;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Energy ledger. Accumulates how long each load was on over a wake cycle
+ * (the deep sleep before a wake plus the wake itself) and weights the times
+ * with per-load current estimates to get the charge used. The last cycle
+ * and a rolling 24h total live in RTC memory and survive deep sleep.
+ *
+ * Rails are switched through gophr_energy_load() from the power functions in
+ * gophr_drivers.c. CPU active vs light sleep comes from the PM light sleep
+ * callbacks (CONFIG_PM_LIGHT_SLEEP_CALLBACKS). The radio counts from stack
+ * start to sleep, less the light sleeps in between: the 802.15.4 radio is
+ * off whenever the CPU light-sleeps between polls.
+ *
+ * gophr_energy_close_cycle() logs one line for host scripts:
+ *
+ *   GENERGY v1 cycle=<n> uah=<cycle> today=<running 24h> day=<last 24h> <load>=<ms> ...
+ */
+
+typedef enum {
+    GOPHR_LOAD_SENSOR_RAIL,     /* GPIO6, moisture probes */
+    GOPHR_LOAD_AHT20_RAIL,      /* GPIO7 */
+    GOPHR_LOAD_LED_RAIL,        /* GPIO18, WS2812B */
+    GOPHR_LOAD_RADIO,           /* On top of CPU active */
+    GOPHR_LOAD_CPU_ACTIVE,
+    GOPHR_LOAD_LIGHT_SLEEP,
+    GOPHR_LOAD_DEEP_SLEEP,
+    GOPHR_LOAD_COUNT,
+} gophr_load_t;
+
+/* Current estimates (uA); override with -DGOPHR_ENERGY_<LOAD>_UA=N or at init */
+#ifndef GOPHR_ENERGY_SENSOR_RAIL_UA
+#define GOPHR_ENERGY_SENSOR_RAIL_UA     6000    /* 3 capacitive probes */
+#endif
+#ifndef GOPHR_ENERGY_AHT20_RAIL_UA
+#define GOPHR_ENERGY_AHT20_RAIL_UA      100     /* Mostly idle between conversions */
+#endif
+#ifndef GOPHR_ENERGY_LED_RAIL_UA
+#define GOPHR_ENERGY_LED_RAIL_UA        1000    /* WS2812B quiescent */
+#endif
+#ifndef GOPHR_ENERGY_RADIO_UA
+#define GOPHR_ENERGY_RADIO_UA           50000   /* 802.15.4 RX/TX over CPU active */
+#endif
+#ifndef GOPHR_ENERGY_CPU_ACTIVE_UA
+#define GOPHR_ENERGY_CPU_ACTIVE_UA      20000
+#endif
+#ifndef GOPHR_ENERGY_LIGHT_SLEEP_UA
+#define GOPHR_ENERGY_LIGHT_SLEEP_UA     250     /* Board total */
+#endif
+#ifndef GOPHR_ENERGY_DEEP_SLEEP_UA
+#define GOPHR_ENERGY_DEEP_SLEEP_UA      20      /* Board total */
+#endif
+
+#define GOPHR_ENERGY_DAY_MS     (24U * 60U * 60U * 1000U)
+
+typedef struct {
+    uint32_t load_ms[GOPHR_LOAD_COUNT];     /* Last closed cycle */
+    uint32_t cycle_uah;                     /* Charge of the last closed cycle */
+    uint32_t today_uah;                     /* Running total of the current 24h period */
+    uint32_t day_uah;                       /* Last complete 24h period, 0 until there is one */
+    uint32_t cycles;
+} gophr_energy_summary_t;
+
+/*
+ * Start the ledger at boot (before the rails are touched). After a deep
+ * sleep the time asleep opens the new cycle. currents_ua: GOPHR_LOAD_COUNT
+ * entries, NULL for the defaults.
+ */
+esp_err_t gophr_energy_init(const uint32_t *currents_ua);
+
+/* A load was switched on or off */
+void gophr_energy_load(gophr_load_t load, bool on);
+
+/* Close the cycle before sleeping and log it; `deep` = the next sleep is deep sleep */
+void gophr_energy_close_cycle(bool deep);
+
+/* Copy the RTC summary */
+void gophr_energy_get(gophr_energy_summary_t *out);
@@ -0,0 +1,92 @@
+#include "gophr_heatshrink.h"
+
+#include <string.h>
+
+typedef enum {
+    HS_TAG = 0,         /* Reading the 1-bit tag */
+    HS_LITERAL,         /* Reading an 8-bit literal */
+    HS_BACKREF_INDEX,   /* Reading window_sz2 bits of offset */
+    HS_BACKREF_COUNT,   /* Reading lookahead_sz2 bits of length */
+    HS_BACKREF_COPY,    /* Emitting a back-reference */
+} hs_state_t;
+
+bool gophr_hs_decoder_reset(gophr_hs_decoder_t *d, uint8_t window_sz2, uint8_t lookahead_sz2)
+{
+    if (window_sz2 < 4 || window_sz2 > GOPHR_HS_MAX_WINDOW_SZ2) return false;
+    if (lookahead_sz2 < 3 || lookahead_sz2 >= window_sz2) return false;
+
+    memset(d, 0, sizeof(*d));
+    d->window_sz2 = window_sz2;
+    d->lookahead_sz2 = lookahead_sz2;
+    d->state = HS_TAG;
+    d->field_bits = 1;
+    return true;
+}
+
+/* Start collecting an n-bit field for the given state */
+static void next_field(gophr_hs_decoder_t *d, hs_state_t state, uint8_t bits)
+{
+    d->state = state;
+    d->field = 0;
+    d->field_bits = bits;
+}
+
+static void emit(gophr_hs_decoder_t *d, uint8_t c, uint8_t *out, size_t *n)
+{
+    uint16_t mask = (uint16_t)((1U << d->window_sz2) - 1);
+    d->window[d->head & mask] = c;
+    d->head++;
+    out[(*n)++] = c;
+}
+
+size_t gophr_hs_decode(gophr_hs_decoder_t *d, const uint8_t *in, size_t in_len,
+                       size_t *consumed, uint8_t *out, size_t out_cap)
+{
+    uint16_t mask = (uint16_t)((1U << d->window_sz2) - 1);
+    size_t used = 0;
+    size_t n = 0;
+
+    while (n < out_cap) {
+        if (d->state == HS_BACKREF_COPY) {
+            while (d->backref_count && n < out_cap) {
+                emit(d, d->window[(uint16_t)(d->head - d->backref_offset) & mask], out, &n);
+                d->backref_count--;
+            }
+            if (d->backref_count) break;
+            next_field(d, HS_TAG, 1);
+            continue;
+        }
+
+        /* Pull one bit into the current field */
+        if (!d->bit_mask) {
+            if (used == in_len) break;
+            d->bit_buf = in[used++];
+            d->bit_mask = 0x80;
+        }
+        d->field = (uint16_t)((d->field << 1) | ((d->bit_buf & d->bit_mask) ? 1 : 0));
+        d->bit_mask >>= 1;
+        if (--d->field_bits) continue;
+
+        switch (d->state) {
+        case HS_TAG:
+            if (d->field) next_field(d, HS_LITERAL, 8);
+            else next_field(d, HS_BACKREF_INDEX, d->window_sz2);
+            break;
+        case HS_LITERAL:
+            emit(d, (uint8_t)d->field, out, &n);
+            next_field(d, HS_TAG, 1);
+            break;
+        case HS_BACKREF_INDEX:
+            d->backref_offset = d->field + 1;
+            next_field(d, HS_BACKREF_COUNT, d->lookahead_sz2);
+            break;
+        case HS_BACKREF_COUNT:
+            d->backref_count = d->field + 1;
+            d->state = HS_BACKREF_COPY;
+            break;
+        }
+    }
+
+    *consumed = used;
+    return n;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Streaming decoder for heatshrink-format LZSS (window_sz2 / lookahead_sz2
+ * as in `heatshrink -w W -l L`). Input and output can be split anywhere;
+ * all state lives in the decoder struct, so it can be parked in RTC memory
+ * between wakes and picked up where it stopped.
+ */
+
+/* Largest window supported (the window buffer is 2^N bytes) */
+#define GOPHR_HS_MAX_WINDOW_SZ2     10
+
+typedef struct {
+    uint8_t window_sz2;
+    uint8_t lookahead_sz2;
+    uint8_t state;
+    uint8_t bit_buf;            /* Current input byte */
+    uint8_t bit_mask;           /* Next bit to read from bit_buf, 0 = need a byte */
+    uint8_t field_bits;         /* Bits still missing from the current field */
+    uint16_t field;             /* Field being assembled, MSB first */
+    uint16_t backref_offset;
+    uint16_t backref_count;     /* Bytes still to copy for the current back-reference */
+    uint16_t head;              /* Window write position */
+    uint8_t window[1 << GOPHR_HS_MAX_WINDOW_SZ2];
+} gophr_hs_decoder_t;
+
+/* Reset for a new stream; false if the parameters are out of range */
+bool gophr_hs_decoder_reset(gophr_hs_decoder_t *d, uint8_t window_sz2, uint8_t lookahead_sz2);
+
+/*
+ * Decode from `in` into `out`. Stops when the input is used up or `out` is
+ * full; *consumed is set to the input bytes taken. Returns the number of
+ * bytes written to `out`. Call again with the same input tail (or more
+ * input) to continue; output pending from a back-reference is kept.
+ */
+size_t gophr_hs_decode(gophr_hs_decoder_t *d, const uint8_t *in, size_t in_len,
+                       size_t *consumed, uint8_t *out, size_t out_cap);
@@ -10,9 +10,19 @@
 #include "gophr_sensors.h"
 #include "gophr_zigbee.h"
 #include "gophr_sleep.h"
+#include "gophr_ota.h"
+#include "gophr_sched.h"
+#include "gophr_wakegate.h"
+#include "gophr_samplelog.h"
+#include "gophr_persist.h"
+#include "gophr_trace.h"
+#include "gophr_energy.h"
 
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_pm.h"
 #include "nvs_flash.h"
+#include <time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_zigbee_core.h"
@@ -22,6 +32,9 @@ static const char *TAG = "gophr_main";
 /* Track boot phase for LED feedback */
 static bool s_boot_complete = false;
 
+/* Warm wake: how long to wait for the network before giving up on the fast path */
+#define WARM_JOIN_TIMEOUT_MS    10000
+
 /* ---------- Zigbee App Signal Handler (required by stack) ---------- */
 
 void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
@@ -29,18 +42,13 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
     gophr_zigbee_signal_handler(signal_struct);
 }
 
-/* ---------- Sensor Reading Task ---------- */
-
-static void sensor_task(void *pvParameters)
+/* Cold boot: power all rails, LED boot indicator, wait for the probes to settle */
+static void boot_sequence(void)
 {
-    /* Boot sequence: match original ESPHome behavior */
     ESP_LOGI(TAG, "Boot sequence: powering on sensors...");
     gophr_sensor_power(true);
-    vTaskDelay(pdMS_TO_TICKS(30000)); /* Wait 30s for sensors to stabilize */
-
     gophr_aht20_power(true);
     gophr_led_power(true);
-    vTaskDelay(pdMS_TO_TICKS(15000)); /* Wait 15s */
 
     /* Init LED and set blue pulse (boot indicator) */
     gophr_led_init();
@@ -49,75 +57,258 @@ static void sensor_task(void *pvParameters)
     /* Init I2C for AHT20 (after power enabled) */
     gophr_i2c_init();
 
-    /* Wait for moisture sensors to read > 0.9V (30s timeout) */
+    /* Wait for moisture readings to settle (30s timeout) */
     ESP_LOGI(TAG, "Waiting for moisture sensors to stabilize...");
+    if (gophr_sensors_wait_settled(SETTLE_TIMEOUT_MS) == ESP_OK) {
+        ESP_LOGI(TAG, "All moisture sensors ready");
+    } else {
+        ESP_LOGW(TAG, "Moisture sensor timeout - continuing anyway");
+    }
+}
+
+/* ---------- Offline Sample Log ---------- */
+
+#define BACKFILL_FRAMES_PER_WINDOW  4       /* Backlog frames sent per sensor window */
+#define BACKFILL_GAP_MS             250     /* Pause between backlog frames */
+
+/* Keep a reading that could not go out; it is streamed once back on the network */
+static void log_offline_sample(const sensor_readings_t *readings)
+{
+    gophr_sample_t sample = {0};
+    sample.time_s = (uint32_t)time(NULL);
+    for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
+        sample.moisture[i] = (uint16_t)(readings->moisture_percent[i] * 100.0f);
+    }
+    sample.temperature = (int16_t)(readings->temperature * 100.0f);
+    sample.humidity = (uint16_t)(readings->humidity * 100.0f);
+    sample.battery_mv = (uint16_t)(readings->battery_voltage * 1000.0f);
+    gophr_samplelog_append(&sample);
+}
+
+/* Stream part of the backlog, oldest first; a few frames per window keeps the radio duty low */
+static void backfill(void)
+{
+    gophr_sample_t samples[GOPHR_ZB_BACKLOG_PER_FRAME];
+    for (int f = 0; f < BACKFILL_FRAMES_PER_WINDOW && gophr_zigbee_is_joined(); f++) {
+        int n = gophr_samplelog_peek(samples, GOPHR_ZB_BACKLOG_PER_FRAME);
+        if (!n) break;
+        if (gophr_zigbee_send_backlog(samples, n) != ESP_OK) break;
+        gophr_samplelog_ack(samples[n - 1].seq);
+        vTaskDelay(pdMS_TO_TICKS(BACKFILL_GAP_MS));
+    }
+}
+
+/* ---------- Wake Gating ---------- */
+
+/* Survives deep sleep: moisture last reported and wakes skipped since */
+static RTC_DATA_ATTR gophr_wakegate_t s_wakegate;
+
+static void gate_moisture(const sensor_readings_t *readings, uint16_t out[GOPHR_WAKEGATE_CHANNELS])
+{
+    for (int i = 0; i < GOPHR_WAKEGATE_CHANNELS; i++) {
+        out[i] = (uint16_t)(readings->moisture_percent[i] * 100.0f);
+    }
+}
+
+/*
+ * The coordinator confirmed a report carrying this moisture: next wakes
+ * compare against it. Never called for a report that was not confirmed,
+ * so the gate only skips wakes against values the network really has.
+ */
+static void gate_reported(const sensor_readings_t *readings)
+{
+    uint16_t moisture[GOPHR_WAKEGATE_CHANNELS];
+    gate_moisture(readings, moisture);
+    gophr_wakegate_reported(&s_wakegate, moisture);
+}
+
+/*
+ * Warm wake, before the radio starts: take the moisture sample and go
+ * straight back to sleep if no channel moved far enough. Returns only if
+ * this wake should report, or an OTA download needs the radio to go on.
+ */
+static void gate_warm_wake(void)
+{
+    gophr_sensor_power(true);
+    gophr_aht20_power(true);
+    gophr_i2c_init();
+
+    if (gophr_sensors_wait_settled(SETTLE_TIMEOUT_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "Moisture sensor timeout - sampling anyway");
+    }
+    gophr_sensors_read_burst();
+
+    sensor_readings_t readings;
+    gophr_sensors_get_readings(&readings);
+    uint16_t moisture[GOPHR_WAKEGATE_CHANNELS];
+    gate_moisture(&readings, moisture);
+
+    int duration = gophr_sleep_get_interval();
+    int max_skips = GOPHR_WAKEGATE_MAX_INTERVAL_MIN / (duration > 0 ? duration : 1) - 1;
+    gophr_wakegate_cfg_t cfg = {
+        .delta = GOPHR_WAKEGATE_DELTA,
+        .max_skips = (uint16_t)(max_skips > 0 ? max_skips : 0),
+    };
+    if (!gophr_wakegate_sample(&s_wakegate, &cfg, moisture) && !gophr_ota_in_progress()) {
+        gophr_sleep_skip_wake();
+    }
+}
+
+/*
+ * Warm (timer) wake: no LED, one filtered measurement set, push it and go
+ * straight back to sleep. Returns only if the device could not sleep again.
+ */
+static void warm_wake_cycle(void)
+{
+    ESP_LOGI(TAG, "Warm wake: measure -> report -> sleep");
+
+    /* Moisture was sampled by the wake gate; rails and I2C are already up */
+    gophr_sensors_trigger_aht20();
+    gophr_sensors_read_aht20();
+
+    /* The stack restores the network from NVS; give it a bounded time to rejoin */
     uint32_t wait_start = xTaskGetTickCount();
-    bool sensors_ready = false;
+    while (!gophr_zigbee_is_joined() &&
+           (xTaskGetTickCount() - wait_start) * portTICK_PERIOD_MS < WARM_JOIN_TIMEOUT_MS) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    if (!gophr_zigbee_is_joined()) {
+        ESP_LOGW(TAG, "Not back on the network - staying awake");
+        sensor_readings_t readings;
+        gophr_sensors_get_readings(&readings);
+        log_offline_sample(&readings);
+        return;
+    }
 
-    while (!sensors_ready && ((xTaskGetTickCount() - wait_start) * portTICK_PERIOD_MS < 30000)) {
-        gophr_sensors_read_moisture();
-        const sensor_readings_t *r = gophr_sensors_get_readings();
+    sensor_readings_t readings;
+    gophr_sensors_get_readings(&readings);
+    for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
+        gophr_zigbee_stage_moisture(i, readings.moisture_percent[i]);
+    }
+    gophr_zigbee_stage_temperature(readings.temperature);
+    gophr_zigbee_stage_humidity(readings.humidity);
+    gophr_zigbee_stage_battery(readings.battery_voltage, readings.battery_percent);
+    gophr_energy_summary_t energy;
+    gophr_energy_get(&energy);
+    gophr_zigbee_stage_energy(&energy);
+    gophr_zigbee_commit();
+
+    /* The sleep sequence's own flush then has nothing left to resend */
+    if (gophr_zigbee_flush_reports(GOPHR_ZB_FLUSH_TIMEOUT_MS, GOPHR_ZB_FLUSH_RETRIES) == ESP_OK) {
+        gate_reported(&readings);
+    }
+    gophr_sleep_now();
+}
 
-        sensors_ready = true;
-        for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
-            if (r->moisture_voltage[i] < 0.9f) {
-                sensors_ready = false;
-                break;
-            }
-        }
+/* Sensor rail dropped between windows; it has to settle again when it comes back */
+static bool s_sensor_rail_idle;
 
-        if (!sensors_ready) {
-            vTaskDelay(pdMS_TO_TICKS(1000));
+/* Make sure the rails a window needs are up (the sleep path may have dropped them) */
+static void power_rails(uint32_t rails)
+{
+    if (rails & GOPHR_RAIL_SENSOR) {
+        gophr_sensor_power(true);
+        if (s_sensor_rail_idle && gophr_sensors_wait_settled(RESETTLE_TIMEOUT_MS) != ESP_OK) {
+            ESP_LOGD(TAG, "Moisture not settled after rail power-up - sampling anyway");
         }
+        s_sensor_rail_idle = false;
     }
+    if (rails & GOPHR_RAIL_AHT20) gophr_aht20_power(true);
+}
 
-    if (sensors_ready) {
-        ESP_LOGI(TAG, "All moisture sensors ready");
+/*
+ * After a window: drop the sensor rail (probes + dividers) when no window
+ * needs it soon. The AHT20 stays up, it idles below 1uA and re-powering it
+ * would need an I2C re-init.
+ */
+static void idle_rails(void)
+{
+    if (!s_sensor_rail_idle && (gophr_sched_idle_rails() & GOPHR_RAIL_SENSOR)) {
+        gophr_sensor_power(false);
+        s_sensor_rail_idle = true;
+    }
+}
+
+/* ---------- Sensor Reading Task ---------- */
+
+static void sensor_task(void *pvParameters)
+{
+    if (gophr_sleep_is_warm_wake()) {
+        warm_wake_cycle();
     } else {
-        ESP_LOGW(TAG, "Moisture sensor timeout - continuing anyway");
+        boot_sequence();
     }
 
     s_boot_complete = true;
     ESP_LOGI(TAG, "Boot complete");
 
     /* ---------- Main sensor loop ---------- */
-    uint32_t loop_count = 0;
-    const uint32_t MOISTURE_INTERVAL_MS = 5000;   /* Read moisture every 5s */
-    const uint32_t AHT20_INTERVAL_LOOPS = 12;     /* Read AHT20 every 60s (12 * 5s) */
-    const uint32_t POWER_INTERVAL_LOOPS = 6;      /* Read power every 30s (6 * 5s) */
-    const uint32_t SLEEP_CHECK_LOOPS = 6;         /* Check sleep every 30s */
+    /* Moisture every 5s, AHT20 every 60s, power and sleep check every 30s (gophr_sched.h) */
+    ESP_ERROR_CHECK(gophr_sched_init(NULL));
 
     while (1) {
-        /* Read moisture sensors every loop (5s) */
-        gophr_sensors_read_moisture();
-        const sensor_readings_t *readings = gophr_sensors_get_readings();
+        /* Block (light sleep) until the next window of due jobs */
+        uint32_t jobs = gophr_sched_wait();
+        bool read_moisture = jobs & GOPHR_JOB_BIT(GOPHR_JOB_MOISTURE);
+        bool read_power = jobs & GOPHR_JOB_BIT(GOPHR_JOB_POWER);
+        bool read_aht20 = jobs & GOPHR_JOB_BIT(GOPHR_JOB_AHT20);
+
+        power_rails(gophr_sched_rails(jobs));
+
+        /* Start the AHT20 conversion first so it overlaps the ADC scan */
+        if (read_aht20) {
+            gophr_sensors_trigger_aht20();
+        }
 
-        /* Update Zigbee moisture attributes */
-        for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
-            gophr_zigbee_update_moisture(i, readings->moisture_percent[i]);
+        /* Battery/solar come from the same scan as moisture */
+        if (read_power) {
+            gophr_sensors_read_adc();
+        } else if (read_moisture) {
+            gophr_sensors_read_moisture();
         }
+        bool aht20_ok = read_aht20 && gophr_sensors_read_aht20() == ESP_OK;
+
+        sensor_readings_t readings;
+        gophr_sensors_get_readings(&readings);
 
-        /* Read AHT20 every 60s */
-        if (loop_count % AHT20_INTERVAL_LOOPS == 0) {
-            if (gophr_sensors_read_aht20() == ESP_OK) {
-                gophr_zigbee_update_temperature(readings->temperature);
-                gophr_zigbee_update_humidity(readings->humidity);
+        /* Stage this window's Zigbee attributes, then write them in one commit */
+        if (read_moisture || read_power) {
+            for (int i = 0; i < MOISTURE_SENSOR_COUNT; i++) {
+                gophr_zigbee_stage_moisture(i, readings.moisture_percent[i]);
             }
         }
 
-        /* Read power every 30s */
-        if (loop_count % POWER_INTERVAL_LOOPS == 0) {
-            gophr_sensors_read_power();
-            gophr_zigbee_update_battery(readings->battery_voltage, readings->battery_percent);
+        if (aht20_ok) {
+            gophr_zigbee_stage_temperature(readings.temperature);
+            gophr_zigbee_stage_humidity(readings.humidity);
+        }
+
+        if (read_power) {
+            gophr_zigbee_stage_battery(readings.battery_voltage, readings.battery_percent);
+            gophr_energy_summary_t energy;
+            gophr_energy_get(&energy);
+            gophr_zigbee_stage_energy(&energy);
+        }
+
+        gophr_zigbee_commit();
+
+        /* Awake between sleeps: push the aggregated report once the soil values move */
+        if (gophr_zigbee_report_changed()) {
+            gate_reported(&readings);
+        }
+
+        /* Off the network: log a sample per power window; back on it: catch up */
+        if (!gophr_zigbee_is_joined()) {
+            if (read_power) log_offline_sample(&readings);
+        } else if (gophr_samplelog_pending()) {
+            backfill();
         }
 
-        /* Check sleep every 30s */
-        if (loop_count % SLEEP_CHECK_LOOPS == 0) {
+        if (jobs & GOPHR_JOB_BIT(GOPHR_JOB_SLEEP)) {
             gophr_sleep_check();
         }
 
-        loop_count++;
-        vTaskDelay(pdMS_TO_TICKS(MOISTURE_INTERVAL_MS));
+        idle_rails();
     }
 }
 
@@ -127,6 +318,7 @@ static void zigbee_task(void *pvParameters)
 {
     /* Initialize Zigbee stack as End Device */
     esp_zb_cfg_t zb_nwk_cfg = GOPHR_ZB_ZED_CONFIG();
+    esp_zb_sleep_enable(true);
     esp_zb_init(&zb_nwk_cfg);
 
     /* Create all endpoints and register device */
@@ -135,17 +327,43 @@ static void zigbee_task(void *pvParameters)
     /* Set channel mask */
     esp_zb_set_primary_network_channel_set(GOPHR_CHANNEL_MASK);
 
+    /* Sleepy end device: radio off between polls to the parent */
+    esp_zb_set_rx_on_when_idle(false);
+
     /* Start Zigbee stack */
+    gophr_trace_mark(GOPHR_PHASE_STACK);
+    gophr_energy_load(GOPHR_LOAD_RADIO, true);
     ESP_ERROR_CHECK(esp_zb_start(false));
 
     /* Enter Zigbee main loop (does not return) */
     esp_zb_stack_main_loop();
 }
 
+/* ---------- Power Management ---------- */
+
+/* Automatic light sleep whenever all tasks are blocked (tickless idle) */
+static esp_err_t power_save_init(void)
+{
+#ifdef CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    return esp_pm_configure(&pm_config);
+#else
+    return ESP_OK;
+#endif
+}
+
 /* ---------- App Main ---------- */
 
 void app_main(void)
 {
+    gophr_trace_start();
+    gophr_trace_mark(GOPHR_PHASE_BOOT);
     ESP_LOGI(TAG, "=== Gophr Zigbee Sensor v1.0.0 ===");
     ESP_LOGI(TAG, "ESP32-C6 | Zigbee End Device");
 
@@ -157,6 +375,14 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
+    /* Settings and calibration are written behind, coalesced over a window */
+    ESP_ERROR_CHECK(gophr_persist_init(GOPHR_PERSIST_WINDOW_MS));
+
+    ESP_ERROR_CHECK(power_save_init());
+
+    /* Energy ledger: opens this cycle with the deep sleep before it, if any */
+    ESP_ERROR_CHECK(gophr_energy_init(NULL));
+
     /* Initialize platform config for Zigbee radio */
     esp_zb_platform_config_t config = {
         .radio_config = ESP_ZB_DEFAULT_RADIO_CONFIG(),
@@ -168,11 +394,23 @@ void app_main(void)
     ESP_ERROR_CHECK(gophr_gpio_init());
     ESP_ERROR_CHECK(gophr_adc_init());
 
-    /* Initialize sensor subsystem (loads calibration from NVS) */
+    /* Initialize sleep subsystem first: it decides whether this is a warm wake */
+    ESP_ERROR_CHECK(gophr_sleep_init());
+
+    /* Initialize sensor subsystem (loads calibration from NVS, or RTC on warm wake) */
     ESP_ERROR_CHECK(gophr_sensors_init());
+    gophr_trace_mark(GOPHR_PHASE_INIT);
 
-    /* Initialize sleep subsystem (loads config from NVS) */
-    ESP_ERROR_CHECK(gophr_sleep_init());
+    /* Samples logged while off the network (runs without it if the partition is missing) */
+    gophr_samplelog_init();
+
+    /* Pick up a partial OTA download left in RTC memory */
+    ESP_ERROR_CHECK(gophr_ota_init());
+
+    /* Warm wake with unchanged soil goes back to sleep here, before the radio starts */
+    if (gophr_sleep_is_warm_wake()) {
+        gate_warm_wake();
+    }
 
     /* Start Zigbee task (high priority, runs the stack main loop) */
     xTaskCreate(zigbee_task, "zigbee_main", 4096, NULL, 5, NULL);
@@ -0,0 +1,354 @@
+#include "gophr_ota.h"
+#include "gophr_zigbee.h"
+#include "gophr_heatshrink.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_attr.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "spi_flash_mmap.h"
+
+static const char *TAG = "gophr_ota";
+
+/* ---------- Download State ---------- */
+
+/*
+ * Everything needed to continue a download lives in RTC memory, so an image
+ * can span several deep-sleep cycles. It is only ever changed from stack
+ * callbacks (stack lock held), and the sleep path takes the same lock, so a
+ * block is never half-applied when the chip goes down.
+ */
+#define OTA_RTC_MAGIC       0x474F5441  /* "GOTA" */
+#define OTA_TAG_LEN         6           /* Sub-element tag id (u16) + length (u32) */
+#define OTA_TAG_UPGRADE_IMAGE 0x0000
+
+typedef enum {
+    OTA_STAGE_TAG = 0,      /* Reading the sub-element tag */
+    OTA_STAGE_FORMAT,       /* Reading the compression header (or first raw bytes) */
+    OTA_STAGE_RAW,          /* Uncompressed image: copy to flash */
+    OTA_STAGE_HS,           /* Compressed image: decode to flash */
+    OTA_STAGE_DONE,         /* Upgrade image complete, ignore the rest */
+} ota_stage_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t file_version;      /* Image being downloaded */
+    uint32_t image_size;        /* Whole OTA file, from its header */
+    uint32_t received;          /* Payload bytes taken from the stack so far */
+    uint32_t element_left;      /* Upgrade-image bytes still expected */
+    uint32_t raw_size;          /* App binary size */
+    uint32_t write_offset;      /* Bytes written to the partition */
+    uint32_t erased_to;         /* Partition erased up to here (sector aligned) */
+    uint32_t partition_addr;    /* Target slot */
+    uint8_t stage;
+    uint8_t prefix_len;
+    uint8_t prefix[GOPHR_OTA_HS_HEADER_LEN];
+    gophr_hs_decoder_t hs;
+} ota_state_t;
+
+static RTC_DATA_ATTR ota_state_t s_ota;
+static const esp_partition_t *s_part = NULL;
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void ota_reset(void)
+{
+    s_ota.magic = 0;
+    s_part = NULL;
+}
+
+/* ---------- Flash Writer ---------- */
+
+/* Sequential write; each sector is erased just before the first write into it */
+static esp_err_t flash_write(const uint8_t *data, size_t len)
+{
+    if (s_ota.write_offset + len > s_part->size) {
+        ESP_LOGE(TAG, "Image larger than slot (%lu bytes)", (unsigned long)s_part->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    while (s_ota.erased_to < s_ota.write_offset + len) {
+        ESP_RETURN_ON_ERROR(esp_partition_erase_range(s_part, s_ota.erased_to, SPI_FLASH_SEC_SIZE),
+                            TAG, "Erase failed at 0x%lx", (unsigned long)s_ota.erased_to);
+        s_ota.erased_to += SPI_FLASH_SEC_SIZE;
+    }
+    ESP_RETURN_ON_ERROR(esp_partition_write(s_part, s_ota.write_offset, data, len),
+                        TAG, "Write failed at 0x%lx", (unsigned long)s_ota.write_offset);
+    s_ota.write_offset += len;
+    return ESP_OK;
+}
+
+/* ---------- Image Stream ---------- */
+
+/* Collect bytes into the prefix buffer; true once `want` bytes are there */
+static bool take_prefix(const uint8_t **data, size_t *len, size_t want)
+{
+    size_t n = want - s_ota.prefix_len;
+    if (n > *len) n = *len;
+    memcpy(s_ota.prefix + s_ota.prefix_len, *data, n);
+    s_ota.prefix_len += n;
+    *data += n;
+    *len -= n;
+    return s_ota.prefix_len == want;
+}
+
+static esp_err_t decode_to_flash(const uint8_t *data, size_t len)
+{
+    uint8_t out[256];
+    size_t n;
+
+    do {
+        size_t used;
+        n = gophr_hs_decode(&s_ota.hs, data, len, &used, out, sizeof(out));
+        data += used;
+        len -= used;
+
+        /* Trailing pad bits can decode to junk past the end */
+        size_t room = s_ota.raw_size - s_ota.write_offset;
+        if (n > room) n = room;
+        if (n) {
+            ESP_RETURN_ON_ERROR(flash_write(out, n), TAG, "Decode write failed");
+        }
+    } while (len || n == sizeof(out));
+    return ESP_OK;
+}
+
+static esp_err_t ota_consume(const uint8_t *data, size_t len)
+{
+    while (len) {
+        if (s_ota.stage == OTA_STAGE_TAG) {
+            if (!take_prefix(&data, &len, OTA_TAG_LEN)) break;
+            uint16_t tag_id = s_ota.prefix[0] | (s_ota.prefix[1] << 8);
+            if (tag_id != OTA_TAG_UPGRADE_IMAGE) {
+                ESP_LOGE(TAG, "Unsupported sub-element 0x%04x", tag_id);
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            s_ota.element_left = le32(s_ota.prefix + 2);
+            s_ota.raw_size = s_ota.element_left;
+            s_ota.prefix_len = 0;
+            s_ota.stage = OTA_STAGE_FORMAT;
+            continue;
+        }
+
+        if (s_ota.stage == OTA_STAGE_DONE) break;
+
+        /* Only the upgrade-image sub-element goes to flash */
+        size_t avail = len < s_ota.element_left ? len : s_ota.element_left;
+        const uint8_t *start = data;
+
+        switch (s_ota.stage) {
+        case OTA_STAGE_FORMAT: {
+            size_t want = (s_ota.prefix_len >= 4 &&
+                           memcmp(s_ota.prefix, GOPHR_OTA_HS_MAGIC, 4) == 0) ? GOPHR_OTA_HS_HEADER_LEN : 4;
+            size_t left = avail;
+            if (!take_prefix(&data, &left, want)) break;
+
+            if (memcmp(s_ota.prefix, GOPHR_OTA_HS_MAGIC, 4) != 0) {
+                /* Plain app image: the bytes read so far are its start */
+                ESP_RETURN_ON_ERROR(flash_write(s_ota.prefix, s_ota.prefix_len), TAG, "Write failed");
+                s_ota.stage = OTA_STAGE_RAW;
+            } else if (want == GOPHR_OTA_HS_HEADER_LEN) {
+                s_ota.raw_size = le32(s_ota.prefix + 8);
+                if (!gophr_hs_decoder_reset(&s_ota.hs, s_ota.prefix[4], s_ota.prefix[5])) {
+                    ESP_LOGE(TAG, "Bad compression parameters w=%d l=%d", s_ota.prefix[4], s_ota.prefix[5]);
+                    return ESP_ERR_INVALID_ARG;
+                }
+                ESP_LOGI(TAG, "Compressed image: %lu bytes (w=%d l=%d)",
+                         (unsigned long)s_ota.raw_size, s_ota.prefix[4], s_ota.prefix[5]);
+                s_ota.stage = OTA_STAGE_HS;
+            }
+            break;
+        }
+        case OTA_STAGE_RAW:
+            ESP_RETURN_ON_ERROR(flash_write(data, avail), TAG, "Write failed");
+            data += avail;
+            break;
+        case OTA_STAGE_HS:
+            ESP_RETURN_ON_ERROR(decode_to_flash(data, avail), TAG, "Decode failed");
+            data += avail;
+            break;
+        }
+
+        size_t used = data - start;
+        len -= used;
+        s_ota.element_left -= used;
+        if (s_ota.element_left == 0) {
+            if (s_ota.write_offset != s_ota.raw_size) {
+                ESP_LOGE(TAG, "Image size mismatch: wrote %lu of %lu",
+                         (unsigned long)s_ota.write_offset, (unsigned long)s_ota.raw_size);
+                return ESP_ERR_INVALID_SIZE;
+            }
+            s_ota.stage = OTA_STAGE_DONE;
+        }
+    }
+    return ESP_OK;
+}
+
+/* ---------- Stack Callbacks ---------- */
+
+static bool can_resume(const esp_zb_zcl_ota_upgrade_value_message_t *message)
+{
+    return s_ota.magic == OTA_RTC_MAGIC && s_part &&
+           s_ota.file_version == message->ota_header.file_version &&
+           s_ota.image_size == message->ota_header.image_size;
+}
+
+static esp_err_t ota_start(const esp_zb_zcl_ota_upgrade_value_message_t *message)
+{
+    if (can_resume(message)) {
+        /* Ask the client to continue from where the last wake stopped */
+        uint32_t file_offset = GOPHR_OTA_FILE_HEADER_LEN + s_ota.received;
+        esp_zb_zcl_set_attribute_val(GOPHR_EP, ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE,
+                                     ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+                                     ESP_ZB_ZCL_ATTR_OTA_UPGRADE_FILE_OFFSET_ID, &file_offset, false);
+        ESP_LOGI(TAG, "Resuming OTA v0x%08lx at %lu/%lu", (unsigned long)s_ota.file_version,
+                 (unsigned long)file_offset, (unsigned long)s_ota.image_size);
+        return ESP_OK;
+    }
+
+    s_part = esp_ota_get_next_update_partition(NULL);
+    ESP_RETURN_ON_FALSE(s_part, ESP_ERR_NOT_FOUND, TAG, "No OTA slot");
+
+    memset(&s_ota, 0, sizeof(s_ota));
+    s_ota.file_version = message->ota_header.file_version;
+    s_ota.image_size = message->ota_header.image_size;
+    s_ota.partition_addr = s_part->address;
+    s_ota.stage = OTA_STAGE_TAG;
+    s_ota.magic = OTA_RTC_MAGIC;
+
+    ESP_LOGI(TAG, "OTA start: v0x%08lx, %lu bytes -> %s", (unsigned long)s_ota.file_version,
+             (unsigned long)s_ota.image_size, s_part->label);
+    return ESP_OK;
+}
+
+esp_err_t gophr_ota_upgrade_cb(const esp_zb_zcl_ota_upgrade_value_message_t *message)
+{
+    if (message->info.status != ESP_ZB_ZCL_STATUS_SUCCESS) {
+        ESP_LOGW(TAG, "OTA status error 0x%x", message->info.status);
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = ESP_OK;
+    switch (message->upgrade_status) {
+    case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_START:
+        ret = ota_start(message);
+        break;
+
+    case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_RECEIVE:
+        if (s_ota.magic != OTA_RTC_MAGIC) return ESP_ERR_INVALID_STATE;
+        ret = ota_consume(message->payload, message->payload_size);
+        if (ret != ESP_OK) {
+            ota_reset();
+            break;
+        }
+        s_ota.received += message->payload_size;
+        break;
+
+    case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_APPLY:
+        ESP_LOGI(TAG, "OTA apply");
+        break;
+
+    case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_CHECK:
+        ret = (s_ota.magic == OTA_RTC_MAGIC && s_ota.stage == OTA_STAGE_DONE) ? ESP_OK : ESP_FAIL;
+        ESP_LOGI(TAG, "OTA check: %s (%lu bytes written)", ret == ESP_OK ? "ok" : "incomplete",
+                 (unsigned long)s_ota.write_offset);
+        break;
+
+    case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_FINISH:
+        ret = esp_ota_set_boot_partition(s_part);   /* Validates the image */
+        ota_reset();
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "New image rejected: %s", esp_err_to_name(ret));
+            break;
+        }
+        ESP_LOGI(TAG, "OTA finished, rebooting");
+        esp_restart();
+        break;
+
+    case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_ABORT:
+    case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_ERROR:
+        ESP_LOGW(TAG, "OTA aborted");
+        ota_reset();
+        break;
+
+    default:
+        ESP_LOGD(TAG, "OTA status %d", message->upgrade_status);
+        break;
+    }
+    return ret;
+}
+
+/* ---------- Cluster ---------- */
+
+esp_err_t gophr_ota_add_cluster(esp_zb_cluster_list_t *cluster_list)
+{
+    esp_zb_ota_cluster_cfg_t ota_cfg = {
+        .ota_upgrade_file_version = GOPHR_OTA_FILE_VERSION,
+        .ota_upgrade_downloaded_file_ver = GOPHR_OTA_FILE_VERSION,
+        .ota_upgrade_manufacturer = GOPHR_OTA_MANUFACTURER,
+        .ota_upgrade_image_type = GOPHR_OTA_IMAGE_TYPE,
+    };
+    esp_zb_attribute_list_t *ota_cluster = esp_zb_ota_cluster_create(&ota_cfg);
+
+    esp_zb_zcl_ota_upgrade_client_variable_t client_cfg = {
+        .timer_query = ESP_ZB_ZCL_OTA_UPGRADE_QUERY_TIMER_COUNT_DEF,
+        .hw_version = GOPHR_OTA_HW_VERSION,
+        .max_data_size = GOPHR_OTA_MAX_DATA_SIZE,
+    };
+    ESP_RETURN_ON_ERROR(esp_zb_ota_cluster_add_attr(ota_cluster,
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_CLIENT_DATA_ID, &client_cfg), TAG, "OTA client data failed");
+
+    uint16_t server_addr = 0xffff;
+    uint8_t server_ep = 0xff;
+    ESP_RETURN_ON_ERROR(esp_zb_ota_cluster_add_attr(ota_cluster,
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_SERVER_ADDR_ID, &server_addr), TAG, "OTA server addr failed");
+    ESP_RETURN_ON_ERROR(esp_zb_ota_cluster_add_attr(ota_cluster,
+        ESP_ZB_ZCL_ATTR_OTA_UPGRADE_SERVER_ENDPOINT_ID, &server_ep), TAG, "OTA server ep failed");
+
+    return esp_zb_cluster_list_add_ota_cluster(cluster_list, ota_cluster, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE);
+}
+
+/* ---------- Init ---------- */
+
+esp_err_t gophr_ota_init(void)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    ESP_LOGI(TAG, "Running from %s (v0x%08x)", running->label, GOPHR_OTA_FILE_VERSION);
+
+    if (s_ota.magic != OTA_RTC_MAGIC) {
+        ota_reset();
+        return ESP_OK;
+    }
+
+    /* Partial download in RTC: only usable if it still targets the next slot */
+    s_part = esp_ota_get_next_update_partition(NULL);
+    if (!s_part || s_part->address != s_ota.partition_addr) {
+        ESP_LOGW(TAG, "Stale OTA state, discarding");
+        ota_reset();
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "OTA download pending: %lu/%lu bytes", (unsigned long)s_ota.received,
+             (unsigned long)s_ota.image_size);
+    return ESP_OK;
+}
+
+void gophr_ota_mark_valid(void)
+{
+    esp_ota_img_states_t state;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+        esp_ota_mark_app_valid_cancel_rollback();
+        ESP_LOGI(TAG, "New firmware confirmed");
+    }
+}
+
+bool gophr_ota_in_progress(void)
+{
+    /* Still set after the last block, until the server says finish or abort */
+    return s_ota.magic == OTA_RTC_MAGIC;
+}
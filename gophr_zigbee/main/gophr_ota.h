@@ -0,0 +1,39 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_zigbee_core.h"
+#include <stdbool.h>
+
+/* ---------- OTA Image Identity ---------- */
+#define GOPHR_OTA_MANUFACTURER      GOPHR_MANUFACTURER_CODE
+#define GOPHR_OTA_IMAGE_TYPE        0x0101
+#define GOPHR_OTA_FILE_VERSION      0x01000000  /* Running firmware (1.0.0) */
+#define GOPHR_OTA_HW_VERSION        0x0101
+#define GOPHR_OTA_MAX_DATA_SIZE     223         /* Image block payload limit */
+
+/* Our OTA files carry no optional header fields */
+#define GOPHR_OTA_FILE_HEADER_LEN   56
+
+/*
+ * Compressed upgrade images: the upgrade-image sub-element starts with this
+ * 12-byte header, followed by a heatshrink stream of the app binary.
+ *   "GHS1" | window_sz2 (u8) | lookahead_sz2 (u8) | reserved (u16) | raw size (u32 LE)
+ * Anything else in the sub-element is written to flash as-is.
+ */
+#define GOPHR_OTA_HS_MAGIC          "GHS1"
+#define GOPHR_OTA_HS_HEADER_LEN     12
+
+/* Check for a download to resume and confirm the running image */
+esp_err_t gophr_ota_init(void);
+
+/* Add the OTA Upgrade client cluster to the endpoint's cluster list */
+esp_err_t gophr_ota_add_cluster(esp_zb_cluster_list_t *cluster_list);
+
+/* Handle ESP_ZB_CORE_OTA_UPGRADE_VALUE_CB_ID from the stack */
+esp_err_t gophr_ota_upgrade_cb(const esp_zb_zcl_ota_upgrade_value_message_t *message);
+
+/* Mark the running image good (call once back on the network) */
+void gophr_ota_mark_valid(void);
+
+/* True from the start of a download until it is applied or aborted (valid after gophr_ota_init) */
+bool gophr_ota_in_progress(void);
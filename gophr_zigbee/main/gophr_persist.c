@@ -0,0 +1,206 @@
+#include "gophr_persist.h"
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <string.h>
+#include <stdatomic.h>
+
+static const char *TAG = "gophr_persist";
+
+/* NVS writes run in their own task, not in the esp_timer task */
+#define PERSIST_TASK_STACK      3072
+#define PERSIST_TASK_PRIORITY   2
+
+typedef struct {
+    const char *ns;
+    gophr_persist_write_fn write;
+} persist_record_t;
+
+static persist_record_t s_records[GOPHR_PERSIST_MAX_RECORDS];
+static int s_record_count;
+static atomic_uint s_dirty;             /* One bit per record */
+static uint32_t s_window_ms;
+static esp_timer_handle_t s_timer;
+static TaskHandle_t s_flush_task;
+static SemaphoreHandle_t s_flush_lock;
+
+/* ---------- Writing ---------- */
+
+/* Open a window unless one is already running; its end flushes everything dirty by then */
+static void arm_window(void)
+{
+    if (s_window_ms == 0 || !s_timer || esp_timer_is_active(s_timer)) return;
+    esp_timer_start_once(s_timer, (uint64_t)s_window_ms * 1000);
+}
+
+static esp_err_t write_record(const persist_record_t *rec)
+{
+    gophr_persist_writer_t w = { .changed = false, .err = ESP_OK };
+    esp_err_t ret = nvs_open(rec->ns, NVS_READWRITE, &w.nvs);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "NVS open %s failed: %s", rec->ns, esp_err_to_name(ret));
+        return ret;
+    }
+
+    rec->write(&w);
+    if (w.changed && w.err == ESP_OK) {
+        w.err = nvs_commit(w.nvs);
+    }
+    nvs_close(w.nvs);
+
+    if (w.err != ESP_OK) {
+        ESP_LOGE(TAG, "Saving %s failed: %s", rec->ns, esp_err_to_name(w.err));
+    } else if (w.changed) {
+        ESP_LOGI(TAG, "Saved %s", rec->ns);
+    } else {
+        ESP_LOGD(TAG, "%s unchanged, nothing written", rec->ns);
+    }
+    return w.err;
+}
+
+esp_err_t gophr_persist_flush(void)
+{
+    if (!s_flush_lock) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_flush_lock, portMAX_DELAY);
+    if (s_timer) esp_timer_stop(s_timer);
+
+    /* Changes marked while writing land in the next flush */
+    uint32_t dirty = atomic_exchange(&s_dirty, 0);
+    esp_err_t ret = ESP_OK;
+    for (int i = 0; i < s_record_count; i++) {
+        if (!(dirty & (1U << i))) continue;
+
+        esp_err_t err = write_record(&s_records[i]);
+        if (err != ESP_OK) {
+            atomic_fetch_or(&s_dirty, 1U << i);     /* Retry on the next flush */
+            if (ret == ESP_OK) ret = err;
+        }
+    }
+
+    /* Failed records (and changes marked meanwhile) get another window */
+    if (atomic_load(&s_dirty)) arm_window();
+    xSemaphoreGive(s_flush_lock);
+    return ret;
+}
+
+static void window_cb(void *arg)
+{
+    xTaskNotifyGive(s_flush_task);
+}
+
+static void flush_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        gophr_persist_flush();
+    }
+}
+
+static void restart_handler(void)
+{
+    gophr_persist_flush();
+}
+
+/* ---------- Init / Records ---------- */
+
+esp_err_t gophr_persist_init(uint32_t window_ms)
+{
+    s_window_ms = window_ms;
+    s_flush_lock = xSemaphoreCreateMutex();
+    if (!s_flush_lock) return ESP_ERR_NO_MEM;
+    if (xTaskCreate(flush_task, "gophr_persist", PERSIST_TASK_STACK, NULL,
+                    PERSIST_TASK_PRIORITY, &s_flush_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t args = {
+        .callback = window_cb,
+        .name = "gophr_persist",
+    };
+    esp_err_t ret = esp_timer_create(&args, &s_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Timer create failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    /* OTA and remote restarts go through esp_restart(); deep sleep flushes explicitly */
+    ret = esp_register_shutdown_handler(restart_handler);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Shutdown handler not registered: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Write-behind window %lums", (unsigned long)window_ms);
+    return ESP_OK;
+}
+
+int gophr_persist_register(const char *ns, gophr_persist_write_fn write)
+{
+    if (s_record_count >= GOPHR_PERSIST_MAX_RECORDS) {
+        ESP_LOGE(TAG, "No room for record %s", ns);
+        return -1;
+    }
+    s_records[s_record_count] = (persist_record_t){ .ns = ns, .write = write };
+    return s_record_count++;
+}
+
+void gophr_persist_mark_dirty(int id)
+{
+    if (id < 0 || id >= s_record_count) return;
+
+    atomic_fetch_or(&s_dirty, 1U << id);
+    if (s_window_ms == 0) {
+        gophr_persist_flush();
+    } else {
+        /* First change opens the window; later ones ride along */
+        arm_window();
+    }
+}
+
+/* ---------- Put Helpers ---------- */
+
+static void put_result(gophr_persist_writer_t *w, esp_err_t err)
+{
+    if (err == ESP_OK) {
+        w->changed = true;
+    } else if (w->err == ESP_OK) {
+        w->err = err;
+    }
+}
+
+void gophr_persist_put_i32(gophr_persist_writer_t *w, const char *key, int32_t value)
+{
+    int32_t stored;
+    if (nvs_get_i32(w->nvs, key, &stored) == ESP_OK && stored == value) return;
+    put_result(w, nvs_set_i32(w->nvs, key, value));
+}
+
+void gophr_persist_put_u8(gophr_persist_writer_t *w, const char *key, uint8_t value)
+{
+    uint8_t stored;
+    if (nvs_get_u8(w->nvs, key, &stored) == ESP_OK && stored == value) return;
+    put_result(w, nvs_set_u8(w->nvs, key, value));
+}
+
+void gophr_persist_put_blob(gophr_persist_writer_t *w, const char *key, const void *data, size_t len)
+{
+    uint8_t stored[GOPHR_PERSIST_BLOB_MAX];
+    size_t sz = sizeof(stored);
+    if (len <= sizeof(stored) && nvs_get_blob(w->nvs, key, stored, &sz) == ESP_OK &&
+        sz == len && memcmp(stored, data, len) == 0) {
+        return;
+    }
+    put_result(w, nvs_set_blob(w->nvs, key, data, len));
+}
+
+void gophr_persist_erase(gophr_persist_writer_t *w, const char *key)
+{
+    esp_err_t err = nvs_erase_key(w->nvs, key);
+    if (err == ESP_ERR_NVS_NOT_FOUND) return;
+    put_result(w, err);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "esp_err.h"
+#include "nvs.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Write-behind NVS persistence. Settings are changed in RAM and the record
+ * is marked dirty; all dirty records are written together once the window
+ * has passed since the first change, before deep sleep (gophr_persist_flush)
+ * and on esp_restart(). Window flushes run in a small task of their own; a
+ * record that fails to save stays dirty and is retried a window later.
+ * Each record writes itself through the put helpers, which compare against
+ * the stored value first, so a change that ends up back at the stored value
+ * costs no flash write and no commit.
+ */
+
+/* Coalescing window; override with -DGOPHR_PERSIST_WINDOW_MS=N (0 = write through) */
+#ifndef GOPHR_PERSIST_WINDOW_MS
+#define GOPHR_PERSIST_WINDOW_MS     60000
+#endif
+#define GOPHR_PERSIST_MAX_RECORDS   4
+#define GOPHR_PERSIST_BLOB_MAX      256     /* Largest blob the put helper can compare */
+
+typedef struct {
+    nvs_handle_t nvs;
+    bool changed;           /* Something was written, commit needed */
+    esp_err_t err;          /* First error, the record stays dirty */
+} gophr_persist_writer_t;
+
+/* Store the record with the gophr_persist_put_* helpers */
+typedef void (*gophr_persist_write_fn)(gophr_persist_writer_t *w);
+
+/* Set up the window timer, flush task and restart hook (call once, after nvs_flash_init) */
+esp_err_t gophr_persist_init(uint32_t window_ms);
+
+/* Register a record kept in NVS namespace `ns`; returns its id, or -1 if the table is full */
+int gophr_persist_register(const char *ns, gophr_persist_write_fn write);
+
+/* The record changed in RAM; it is written when the window expires */
+void gophr_persist_mark_dirty(int id);
+
+/* Write every dirty record now; returns the first error */
+esp_err_t gophr_persist_flush(void);
+
+/* Put helpers: skip the write when NVS already holds the value */
+void gophr_persist_put_i32(gophr_persist_writer_t *w, const char *key, int32_t value);
+void gophr_persist_put_u8(gophr_persist_writer_t *w, const char *key, uint8_t value);
+void gophr_persist_put_blob(gophr_persist_writer_t *w, const char *key, const void *data, size_t len);
+void gophr_persist_erase(gophr_persist_writer_t *w, const char *key);
@@ -0,0 +1,336 @@
+#include "gophr_samplelog.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include <string.h>
+#include <stdbool.h>
+
+static const char *TAG = "gophr_samplelog";
+
+/* On-flash record: the sample and a CRC over it */
+typedef struct {
+    gophr_sample_t sample;
+    uint32_t crc;
+} log_record_t;
+
+#define SLOTS_PER_SECTOR    (GOPHR_SAMPLELOG_SECTOR_SIZE / sizeof(log_record_t))
+
+typedef struct {
+    uint32_t sector;
+    uint32_t slot;
+} log_pos_t;
+
+typedef enum {
+    SLOT_ERASED = 0,
+    SLOT_VALID,
+    SLOT_TORN,          /* Written but fails the CRC (power lost mid-write) */
+} slot_state_t;
+
+static const esp_partition_t *s_part = NULL;
+static uint32_t s_sectors;
+static log_pos_t s_head;            /* Next slot to write */
+static log_pos_t s_read;            /* No undelivered sample before this slot */
+static uint32_t s_next_seq = 1;     /* 0 means "none" */
+static uint32_t s_acked = 0;        /* Last delivered seq */
+static uint32_t s_acks_unsaved = 0;
+
+/* ---------- Slots ---------- */
+
+static bool pos_equal(log_pos_t a, log_pos_t b)
+{
+    return a.sector == b.sector && a.slot == b.slot;
+}
+
+static log_pos_t next_pos(log_pos_t p)
+{
+    if (++p.slot == SLOTS_PER_SECTOR) {
+        p.slot = 0;
+        p.sector = (p.sector + 1) % s_sectors;
+    }
+    return p;
+}
+
+static size_t slot_offset(log_pos_t p)
+{
+    return (size_t)p.sector * GOPHR_SAMPLELOG_SECTOR_SIZE + p.slot * sizeof(log_record_t);
+}
+
+static uint32_t record_crc(const log_record_t *rec)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&rec->sample, sizeof(rec->sample));
+}
+
+static slot_state_t read_slot(log_pos_t p, gophr_sample_t *out)
+{
+    log_record_t rec;
+    if (esp_partition_read(s_part, slot_offset(p), &rec, sizeof(rec)) != ESP_OK) return SLOT_TORN;
+
+    const uint8_t *bytes = (const uint8_t *)&rec;
+    bool erased = true;
+    for (size_t i = 0; i < sizeof(rec) && erased; i++) {
+        erased = bytes[i] == 0xFF;
+    }
+    if (erased) return SLOT_ERASED;
+    if (record_crc(&rec) != rec.crc) return SLOT_TORN;
+
+    if (out) *out = rec.sample;
+    return SLOT_VALID;
+}
+
+/* First valid seq in a sector, 0 if it has none */
+static uint32_t sector_first_seq(uint32_t sector)
+{
+    gophr_sample_t s;
+    for (log_pos_t p = {sector, 0}; p.slot < SLOTS_PER_SECTOR; p.slot++) {
+        slot_state_t state = read_slot(p, &s);
+        if (state == SLOT_VALID) return s.seq;
+        if (state == SLOT_ERASED) return 0;
+    }
+    return 0;
+}
+
+/*
+ * read == head means nothing is pending, except right after the ring fills
+ * up: the head then sits at the start of the oldest sector, which is only
+ * erased by the next append and still holds undelivered samples.
+ */
+static bool ring_full(void)
+{
+    return pos_equal(s_read, s_head) && s_head.slot == 0 && sector_first_seq(s_head.sector) > s_acked;
+}
+
+/* Slots from the read position up to the head (all of them when the ring is full) */
+static uint32_t unread_slots(void)
+{
+    uint32_t total = s_sectors * SLOTS_PER_SECTOR;
+    uint32_t read = s_read.sector * SLOTS_PER_SECTOR + s_read.slot;
+    uint32_t head = s_head.sector * SLOTS_PER_SECTOR + s_head.slot;
+    if (read == head) return ring_full() ? total : 0;
+    return (head + total - read) % total;
+}
+
+/* ---------- Recovery ---------- */
+
+/* The head sector holds the newest first record; the head is its first erased slot */
+static void recover_head(void)
+{
+    uint32_t newest = 0;
+    uint32_t head_sector = 0;
+    for (uint32_t i = 0; i < s_sectors; i++) {
+        uint32_t seq = sector_first_seq(i);
+        if (seq > newest) {
+            newest = seq;
+            head_sector = i;
+        }
+    }
+
+    log_pos_t p = {head_sector, 0};
+    uint32_t last = newest;
+    gophr_sample_t s;
+    while (newest && p.slot < SLOTS_PER_SECTOR) {
+        slot_state_t state = read_slot(p, &s);
+        if (state == SLOT_ERASED) break;
+        if (state == SLOT_VALID) last = s.seq;
+        p.slot++;   /* A torn record is left in place and skipped */
+    }
+    if (p.slot == SLOTS_PER_SECTOR) {
+        p.slot = 0;
+        p.sector = (head_sector + 1) % s_sectors;
+    }
+
+    s_head = p;
+    s_next_seq = (last > s_acked ? last : s_acked) + 1;
+}
+
+/*
+ * Sequence numbers rise around the ring from the oldest sector, so reading
+ * starts at the last sector whose first record is at most acked + 1 (or at
+ * the oldest non-empty sector if everything left is newer).
+ */
+static void recover_read_pos(void)
+{
+    uint32_t oldest = s_head.slot ? (s_head.sector + 1) % s_sectors : s_head.sector;
+    bool found = false;
+    s_read = s_head;
+
+    for (uint32_t k = 0; k < s_sectors; k++) {
+        uint32_t sector = (oldest + k) % s_sectors;
+        uint32_t first = sector_first_seq(sector);
+        if (!first) continue;
+        if (first > s_acked + 1 && found) break;
+
+        s_read.sector = sector;
+        s_read.slot = 0;
+        found = true;
+        if (first > s_acked + 1) break;
+    }
+}
+
+static void save_acked(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open("gophr_log", NVS_READWRITE, &nvs) != ESP_OK) return;
+    nvs_set_u32(nvs, "acked", s_acked);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+    s_acks_unsaved = 0;
+}
+
+esp_err_t gophr_samplelog_init(void)
+{
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, GOPHR_SAMPLELOG_SUBTYPE,
+                                      GOPHR_SAMPLELOG_PARTITION);
+    if (!s_part) {
+        ESP_LOGW(TAG, "No %s partition, offline samples will be dropped", GOPHR_SAMPLELOG_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_sectors = s_part->size / GOPHR_SAMPLELOG_SECTOR_SIZE;
+    if (s_sectors < 2) {
+        s_part = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    nvs_handle_t nvs;
+    s_acked = 0;
+    if (nvs_open("gophr_log", NVS_READONLY, &nvs) == ESP_OK) {
+        nvs_get_u32(nvs, "acked", &s_acked);
+        nvs_close(nvs);
+    }
+
+    recover_head();
+    recover_read_pos();
+
+    ESP_LOGI(TAG, "Sample log: %lu sectors, next seq %lu, %lu pending",
+             (unsigned long)s_sectors, (unsigned long)s_next_seq,
+             (unsigned long)gophr_samplelog_pending());
+    return ESP_OK;
+}
+
+/* ---------- Append / Read ---------- */
+
+esp_err_t gophr_samplelog_append(gophr_sample_t *sample)
+{
+    if (!s_part) return ESP_ERR_INVALID_STATE;
+
+    /* Entering a sector: erase it, dropping the oldest samples if the ring is full */
+    if (s_head.slot == 0) {
+        bool drop = s_read.sector == s_head.sector && unread_slots() != 0;
+        ESP_RETURN_ON_ERROR(esp_partition_erase_range(s_part, slot_offset(s_head),
+                                                      GOPHR_SAMPLELOG_SECTOR_SIZE),
+                            TAG, "Sector erase failed");
+        if (drop) {
+            ESP_LOGW(TAG, "Log full, dropping oldest undelivered samples");
+            s_read.sector = (s_head.sector + 1) % s_sectors;
+            s_read.slot = 0;
+        }
+    }
+
+    log_record_t rec = { .sample = *sample };
+    rec.sample.seq = s_next_seq;
+    rec.crc = record_crc(&rec);
+
+    esp_err_t ret = esp_partition_write(s_part, slot_offset(s_head), &rec, sizeof(rec));
+
+    /* Never write a slot twice; a failed one reads back as torn */
+    s_head = next_pos(s_head);
+    s_next_seq++;
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Record write failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    sample->seq = rec.sample.seq;
+    return ESP_OK;
+}
+
+uint32_t gophr_samplelog_pending(void)
+{
+    if (!s_part || !unread_slots()) return 0;
+    return s_next_seq - 1 - s_acked;
+}
+
+int gophr_samplelog_peek_after(uint32_t seq, gophr_sample_t *out, int max)
+{
+    if (!s_part) return 0;
+    if (seq < s_acked) seq = s_acked;
+
+    int n = 0;
+    bool undelivered = false;
+    gophr_sample_t s;
+    log_pos_t p = s_read;
+    for (uint32_t left = unread_slots(); n < max && left; left--, p = next_pos(p)) {
+        bool valid = read_slot(p, &s) == SLOT_VALID;
+        if (valid && s.seq > seq) {
+            out[n++] = s;
+        }
+        if (valid && s.seq > s_acked) {
+            undelivered = true;
+        } else if (!undelivered) {
+            s_read = next_pos(p);   /* Nothing undelivered up to here */
+        }
+    }
+    return n;
+}
+
+int gophr_samplelog_peek(gophr_sample_t *out, int max)
+{
+    return gophr_samplelog_peek_after(0, out, max);
+}
+
+void gophr_samplelog_ack(uint32_t seq)
+{
+    if (!s_part || seq <= s_acked) return;
+    s_acked = seq;
+
+    /* Move the read position past what was just delivered */
+    gophr_sample_t s;
+    for (uint32_t left = unread_slots(); left; left--) {
+        if (read_slot(s_read, &s) == SLOT_VALID && s.seq > s_acked) break;
+        s_read = next_pos(s_read);
+    }
+
+    if (++s_acks_unsaved >= GOPHR_SAMPLELOG_ACK_SAVE_EVERY || !unread_slots()) {
+        save_acked();
+    }
+}
+
+/* ---------- Backlog Frame ---------- */
+
+static size_t put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+    return 2;
+}
+
+static size_t put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, v & 0xffff);
+    put_u16(p + 2, v >> 16);
+    return 4;
+}
+
+size_t gophr_samplelog_pack(uint8_t *buf, size_t cap, uint32_t now_s,
+                            const gophr_sample_t *samples, int count)
+{
+    size_t len = GOPHR_BACKLOG_HEADER_LEN + (size_t)count * GOPHR_SAMPLE_PACKED_LEN;
+    if (count < 0 || count > 255 || len > cap) return 0;
+
+    uint8_t *p = buf;
+    p += put_u32(p, now_s);
+    *p++ = (uint8_t)count;
+    for (int i = 0; i < count; i++) {
+        const gophr_sample_t *s = &samples[i];
+        p += put_u32(p, s->seq);
+        p += put_u32(p, s->time_s);
+        for (int ch = 0; ch < 3; ch++) {
+            p += put_u16(p, s->moisture[ch]);
+        }
+        p += put_u16(p, (uint16_t)s->temperature);
+        p += put_u16(p, s->humidity);
+        p += put_u16(p, s->battery_mv);
+    }
+    return len;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Store-and-forward sample log. Readings taken while the device is off the
+ * network are appended to a ring of fixed-size records on the "samplelog"
+ * data partition, and streamed to the controller once it is back.
+ *
+ * Records are written strictly in order around the ring, one sector erased
+ * just before it is reused, so wear is spread evenly over the partition.
+ * Each record carries a sequence number and a CRC; after a power loss the
+ * head is found from the highest valid sequence number and a torn record
+ * is simply skipped. The last delivered sequence number is kept in NVS.
+ */
+
+#define GOPHR_SAMPLELOG_PARTITION   "samplelog"
+#define GOPHR_SAMPLELOG_SUBTYPE     0x40        /* Custom data subtype */
+#define GOPHR_SAMPLELOG_SECTOR_SIZE 4096
+#define GOPHR_SAMPLELOG_ACK_SAVE_EVERY 16       /* Persist the ack every N acks (and when drained) */
+
+/* One sample; the values use the Zigbee/Matter attribute units */
+typedef struct {
+    uint32_t seq;           /* Assigned by the log */
+    uint32_t time_s;        /* Device time (seconds) when sampled */
+    uint16_t moisture[3];   /* 0.01% */
+    int16_t temperature;    /* 0.01°C */
+    uint16_t humidity;      /* 0.01% */
+    uint16_t battery_mv;
+} gophr_sample_t;
+
+/* Packed size of one sample in a backlog frame */
+#define GOPHR_SAMPLE_PACKED_LEN     20
+/* Backlog frame header: sender's device time (u32) + sample count (u8) */
+#define GOPHR_BACKLOG_HEADER_LEN    5
+
+/* Find the partition and recover the head, sequence and read position */
+esp_err_t gophr_samplelog_init(void);
+
+/* Append a sample (seq is filled in); the oldest sector is dropped when full */
+esp_err_t gophr_samplelog_append(gophr_sample_t *sample);
+
+/* Number of samples not yet delivered */
+uint32_t gophr_samplelog_pending(void);
+
+/* Copy up to `max` of the oldest undelivered samples; returns the count */
+int gophr_samplelog_peek(gophr_sample_t *out, int max);
+
+/*
+ * Same, skipping samples up to `seq`: for a transport whose delivery is
+ * confirmed later, so samples already sent stay in the log until acked.
+ */
+int gophr_samplelog_peek_after(uint32_t seq, gophr_sample_t *out, int max);
+
+/* Everything up to and including `seq` has been delivered */
+void gophr_samplelog_ack(uint32_t seq);
+
+/*
+ * Pack samples into a backlog frame, all fields little-endian:
+ *   now_s (u32) | count (u8) | count x { seq (u32) | time_s (u32) |
+ *   moisture[3] (u16) | temperature (s16) | humidity (u16) | battery_mv (u16) }
+ * The receiver dates each sample as (its clock) - (now_s - time_s).
+ * Returns the frame length, 0 if it does not fit.
+ */
+size_t gophr_samplelog_pack(uint8_t *buf, size_t cap, uint32_t now_s,
+                            const gophr_sample_t *samples, int count);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+
+/*
+ * Deadline scheduler for the periodic sensor work. Each job has its own
+ * period, a jitter tolerance (how late it may run) and the power rails it
+ * needs. A single esp_timer one-shot is armed for the next window: jobs
+ * whose deadlines are close enough are delayed (within their tolerance) to
+ * share one powered window. Between windows the sensor task is blocked, so
+ * the CPU light-sleeps, and a rail no job needs for a while is dropped
+ * (gophr_sched_idle_rails) until the next window that uses it.
+ */
+
+/* Jobs, in the order they run inside a window */
+typedef enum {
+    GOPHR_JOB_MOISTURE = 0,
+    GOPHR_JOB_AHT20,
+    GOPHR_JOB_POWER,        /* Battery + solar */
+    GOPHR_JOB_SLEEP,        /* Sleep policy check */
+    GOPHR_JOB_COUNT,
+} gophr_job_t;
+
+#define GOPHR_JOB_BIT(job)      (1U << (job))
+
+/* Power rails a job needs */
+#define GOPHR_RAIL_SENSOR       (1U << 0)   /* Moisture probes + battery/solar dividers */
+#define GOPHR_RAIL_AHT20        (1U << 1)
+
+typedef struct {
+    uint32_t period_ms;
+    uint32_t jitter_ms;     /* May run up to this much after its deadline */
+    uint32_t rails;         /* GOPHR_RAIL_* */
+} gophr_job_cfg_t;
+
+/* Default periods and tolerances */
+#define GOPHR_SCHED_MOISTURE_PERIOD_MS  5000
+#define GOPHR_SCHED_MOISTURE_JITTER_MS  500
+#define GOPHR_SCHED_AHT20_PERIOD_MS     60000
+#define GOPHR_SCHED_AHT20_JITTER_MS     5000    /* Lets it join a moisture window */
+#define GOPHR_SCHED_POWER_PERIOD_MS     30000
+#define GOPHR_SCHED_POWER_JITTER_MS     5000
+#define GOPHR_SCHED_SLEEP_PERIOD_MS     30000
+#define GOPHR_SCHED_SLEEP_JITTER_MS     10000
+
+/*
+ * A rail needed again sooner than this stays up. Re-powering the sensor
+ * rail costs a settle (about 2s, up to RESETTLE_TIMEOUT_MS for a dry or
+ * unplugged probe), so the hold covers a whole moisture period plus its
+ * jitter: with the default periods the rail stays up while awake and is
+ * only dropped for jobs that are far apart.
+ */
+#ifndef GOPHR_SCHED_RAIL_HOLD_MS
+#define GOPHR_SCHED_RAIL_HOLD_MS        (GOPHR_SCHED_MOISTURE_PERIOD_MS + 2 * GOPHR_SCHED_MOISTURE_JITTER_MS)
+#endif
+
+/* Create the timer with the given job table (NULL = defaults); every job is due immediately */
+esp_err_t gophr_sched_init(const gophr_job_cfg_t *jobs);
+
+/*
+ * Block the calling task until the next window and return the jobs due in
+ * it (GOPHR_JOB_BIT mask). The returned jobs are rescheduled one period
+ * from now. Call from a single task.
+ */
+uint32_t gophr_sched_wait(void);
+
+/* Union of the rails needed by a set of jobs */
+uint32_t gophr_sched_rails(uint32_t jobs);
+
+/* Rails no job needs within GOPHR_SCHED_RAIL_HOLD_MS; call after a window's jobs */
+uint32_t gophr_sched_idle_rails(void);
@@ -0,0 +1,24 @@
+#include "gophr_seqlock.h"
+
+#include <string.h>
+
+void gophr_seqlock_write(gophr_seqlock_t *sl, void *copies, const void *src, size_t size)
+{
+    for (int i = 0; i < 2; i++) {
+        /* Odd sequence steers readers to copy 1 while copy 0 is written, and vice versa */
+        atomic_thread_fence(memory_order_release);
+        atomic_fetch_add_explicit(&sl->seq, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        memcpy((char *)copies + i * size, src, size);
+    }
+}
+
+void gophr_seqlock_read(gophr_seqlock_t *sl, const void *copies, void *dst, size_t size)
+{
+    unsigned seq;
+    do {
+        seq = atomic_load_explicit(&sl->seq, memory_order_acquire);
+        memcpy(dst, (const char *)copies + (seq & 1) * size, size);
+        atomic_thread_fence(memory_order_acquire);
+    } while (seq != atomic_load_explicit(&sl->seq, memory_order_relaxed));
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+/*
+ * Single-writer latched seqlock over two copies of a value. The writer
+ * updates the copies in turn and readers always copy the one not being
+ * written, so a reader never waits on the writer and no mutex is
+ * involved. A reader only retries if the writer moved on to its copy
+ * while it was reading.
+ *
+ * Plain C11 atomics, so it builds and is stress-tested on the host.
+ */
+
+typedef struct {
+    atomic_uint seq;
+} gophr_seqlock_t;
+
+/* Publish `size` bytes from src into copies[0..1] (one writer at a time) */
+void gophr_seqlock_write(gophr_seqlock_t *sl, void *copies, const void *src, size_t size);
+
+/* Copy a consistent snapshot out of copies[0..1] (any number of readers) */
+void gophr_seqlock_read(gophr_seqlock_t *sl, const void *copies, void *dst, size_t size);
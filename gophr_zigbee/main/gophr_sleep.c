@@ -1,8 +1,15 @@
 #include "gophr_sleep.h"
 #include "gophr_drivers.h"
+#include "gophr_sensors.h"
+#include "gophr_persist.h"
+#include "gophr_trace.h"
+#include "gophr_energy.h"
+#include "gophr_duty.h"
 #include "gophr_zigbee.h"
+#include "gophr_ota.h"
 
 #include "esp_log.h"
+#include "esp_attr.h"
 #include "esp_sleep.h"
 #include "nvs_flash.h"
 #include "nvs.h"
@@ -11,12 +18,28 @@
 
 static const char *TAG = "gophr_sleep";
 
-static int s_sleep_duration_min;
-static int s_min_awake_min;
-static int s_max_awake_min;
-static bool s_sleep_disabled;
+/* Sleep config and network state survive deep sleep in RTC memory */
+#define SLEEP_RTC_MAGIC     0x47534C50  /* "GSLP" */
+static RTC_DATA_ATTR uint32_t s_rtc_magic;
+static RTC_DATA_ATTR uint32_t s_wake_count;
+static RTC_DATA_ATTR bool s_rtc_joined;
+
+static RTC_DATA_ATTR int s_sleep_duration_min;
+static RTC_DATA_ATTR int s_min_awake_min;
+static RTC_DATA_ATTR int s_max_awake_min;
+static RTC_DATA_ATTR bool s_sleep_disabled;
+static RTC_DATA_ATTR int s_min_interval_min;
+static RTC_DATA_ATTR int s_max_interval_min;
+
+/* Adapted to the power state before each sleep (gophr_duty.h) */
+static RTC_DATA_ATTR int s_interval_min;
+static RTC_DATA_ATTR int s_awake_window_min;
+static RTC_DATA_ATTR uint32_t s_dark_min;
+static RTC_DATA_ATTR int s_tighten_pm;
 static uint32_t s_awake_start_ms;
 static bool s_sleep_sequence_active = false;
+static bool s_warm_wake = false;
+static int s_config_record = -1;
 
 /* ---------- NVS Persistence ---------- */
 
@@ -29,6 +52,8 @@ static void load_config(void)
         s_min_awake_min = GOPHR_DEFAULT_MIN_AWAKE_MIN;
         s_max_awake_min = GOPHR_DEFAULT_MAX_AWAKE_MIN;
         s_sleep_disabled = GOPHR_DEFAULT_SLEEP_DISABLED;
+        s_min_interval_min = GOPHR_DEFAULT_MIN_INTERVAL_MIN;
+        s_max_interval_min = GOPHR_DEFAULT_MAX_INTERVAL_MIN;
         return;
     }
 
@@ -47,22 +72,32 @@ static void load_config(void)
     if (nvs_get_u8(nvs, "disabled", &bval) == ESP_OK) s_sleep_disabled = (bval != 0);
     else s_sleep_disabled = GOPHR_DEFAULT_SLEEP_DISABLED;
 
+    if (nvs_get_i32(nvs, "min_intv", &val) == ESP_OK) s_min_interval_min = val;
+    else s_min_interval_min = GOPHR_DEFAULT_MIN_INTERVAL_MIN;
+
+    if (nvs_get_i32(nvs, "max_intv", &val) == ESP_OK) s_max_interval_min = val;
+    else s_max_interval_min = GOPHR_DEFAULT_MAX_INTERVAL_MIN;
+
     nvs_close(nvs);
-    ESP_LOGI(TAG, "Sleep config: duration=%dmin, min_awake=%dmin, max_awake=%dmin, disabled=%d",
-             s_sleep_duration_min, s_min_awake_min, s_max_awake_min, s_sleep_disabled);
+    ESP_LOGI(TAG, "Sleep config: duration=%dmin, min_awake=%dmin, max_awake=%dmin, disabled=%d, "
+             "interval=%d..%dmin", s_sleep_duration_min, s_min_awake_min, s_max_awake_min,
+             s_sleep_disabled, s_min_interval_min, s_max_interval_min);
 }
 
-static void save_config(void)
+static void write_config(gophr_persist_writer_t *w)
 {
-    nvs_handle_t nvs;
-    if (nvs_open("gophr_sleep", NVS_READWRITE, &nvs) != ESP_OK) return;
+    gophr_persist_put_i32(w, "duration", s_sleep_duration_min);
+    gophr_persist_put_i32(w, "min_awake", s_min_awake_min);
+    gophr_persist_put_i32(w, "max_awake", s_max_awake_min);
+    gophr_persist_put_u8(w, "disabled", s_sleep_disabled ? 1 : 0);
+    gophr_persist_put_i32(w, "min_intv", s_min_interval_min);
+    gophr_persist_put_i32(w, "max_intv", s_max_interval_min);
+}
 
-    nvs_set_i32(nvs, "duration", s_sleep_duration_min);
-    nvs_set_i32(nvs, "min_awake", s_min_awake_min);
-    nvs_set_i32(nvs, "max_awake", s_max_awake_min);
-    nvs_set_u8(nvs, "disabled", s_sleep_disabled ? 1 : 0);
-    nvs_commit(nvs);
-    nvs_close(nvs);
+/* Write-behind: setters called back to back end up in one commit */
+static void save_config(void)
+{
+    gophr_persist_mark_dirty(s_config_record);
 }
 
 /* ---------- Init ---------- */
@@ -71,38 +106,151 @@ esp_err_t gophr_sleep_init(void)
 {
     s_awake_start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
     s_sleep_sequence_active = false;
+    s_config_record = gophr_persist_register("gophr_sleep", write_config);
+
+    /* Warm wake: our own timer wake, with RTC state written just before sleeping */
+    s_warm_wake = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER &&
+                  s_rtc_magic == SLEEP_RTC_MAGIC && s_rtc_joined;
+    s_rtc_magic = 0;
+
+    if (s_warm_wake) {
+        s_wake_count++;
+        ESP_LOGI(TAG, "Warm wake #%lu (config from RTC)", (unsigned long)s_wake_count);
+        return ESP_OK;
+    }
+
+    s_wake_count = 0;
     load_config();
+    s_interval_min = s_sleep_duration_min;
+    s_awake_window_min = s_min_awake_min;
+    s_dark_min = 0;
+    s_tighten_pm = 0;
     return ESP_OK;
 }
 
+/* ---------- Duty Cycle ---------- */
+
+typedef struct {
+    gophr_duty_t duty;
+    uint32_t dark_min;          /* s_dark_min once this sleep is over */
+} sleep_plan_t;
+
+/*
+ * Pick the next sleep interval and awake window from the latest power
+ * reading. Nothing is changed until the sleep really starts (apply_plan),
+ * so an aborted sleep sequence leaves the dark-time count alone.
+ */
+static sleep_plan_t plan_next_sleep(void)
+{
+    sensor_readings_t readings;
+    gophr_sensors_get_readings(&readings);
+
+    uint32_t dark_min = 0;
+    if (!readings.solar_charging) {
+        dark_min = s_dark_min + gophr_sleep_get_awake_seconds() / 60;
+    }
+
+    const gophr_duty_state_t state = {
+        .battery_percent = readings.battery_percent,
+        .solar_charging = readings.solar_charging,
+        .dark_min = dark_min,
+        .tighten_pm = s_tighten_pm,
+    };
+    const gophr_duty_settings_t settings = {
+        .sleep_min = s_sleep_duration_min,
+        .min_awake_min = s_min_awake_min,
+        .min_interval_min = s_min_interval_min,
+        .max_interval_min = s_max_interval_min,
+    };
+    sleep_plan_t plan = {
+        .duty = gophr_duty_policy(&state, &settings),
+        .dark_min = dark_min,
+    };
+
+    if (plan.duty.sleep_min != s_interval_min || plan.duty.min_awake_min != s_awake_window_min) {
+        ESP_LOGI(TAG, "Duty cycle: sleep %d min, min awake %d min (battery %.0f%%, %s)",
+                 plan.duty.sleep_min, plan.duty.min_awake_min, readings.battery_percent,
+                 readings.solar_charging ? "charging" : "no solar");
+    }
+    if (!readings.solar_charging) {
+        plan.dark_min += (uint32_t)plan.duty.sleep_min;
+    }
+    return plan;
+}
+
+/* The sleep is going ahead: make the plan current */
+static void apply_plan(const sleep_plan_t *plan)
+{
+    s_interval_min = plan->duty.sleep_min;
+    s_awake_window_min = plan->duty.min_awake_min;
+    s_dark_min = plan->dark_min;
+    s_tighten_pm = plan->duty.tighten_pm;
+}
+
 /* ---------- Sleep Execution ---------- */
 
 static void enter_deep_sleep(void)
 {
-    uint64_t sleep_us = (uint64_t)s_sleep_duration_min * 60ULL * 1000000ULL;
-    ESP_LOGI(TAG, "Entering deep sleep for %d minutes", s_sleep_duration_min);
+    uint64_t sleep_us = (uint64_t)s_interval_min * 60ULL * 1000000ULL;
+    ESP_LOGI(TAG, "Entering deep sleep for %d minutes", s_interval_min);
+
+    /* Leave state for the warm-wake path */
+    s_rtc_joined = gophr_zigbee_is_joined();
+    s_rtc_magic = SLEEP_RTC_MAGIC;
+
+    /* Hold the stack so no callback (e.g. an OTA block write) is cut in half */
+    esp_zb_lock_acquire(portMAX_DELAY);
 
     esp_sleep_enable_timer_wakeup(sleep_us);
     esp_deep_sleep_start();
     /* Device resets on wake - code below never executes */
 }
 
+/*
+ * Short sleeps: stay joined as a sleepy end device. The task just blocks;
+ * with tickless idle the CPU and radio light-sleep between parent polls,
+ * and the stack keeps its network and reporting state.
+ */
+static void stay_joined_sleep(void)
+{
+    ESP_LOGI(TAG, "Light sleeping for %d minutes (staying joined)", s_interval_min);
+    vTaskDelay(pdMS_TO_TICKS((uint32_t)s_interval_min * 60U * 1000U));
+
+    ESP_LOGI(TAG, "Light sleep done, powering sensors");
+    gophr_trace_start();
+    gophr_sensor_power(true);
+    if (gophr_sensors_wait_settled(SETTLE_TIMEOUT_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "Moisture sensor timeout - continuing anyway");
+    }
+
+    s_awake_start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    s_sleep_sequence_active = false;
+}
+
 static void sleep_sequence(void)
 {
     s_sleep_sequence_active = true;
-    ESP_LOGI(TAG, "Sleep sequence started");
+    gophr_trace_mark(GOPHR_PHASE_SLEEP_SEQ);
+
+    sleep_plan_t plan = plan_next_sleep();
+    bool stay_joined = plan.duty.sleep_min <= GOPHR_LIGHT_SLEEP_MAX_MIN;
+    ESP_LOGI(TAG, "Sleep sequence started (%s)", stay_joined ? "light" : "deep");
 
-    /* Power down sensors */
+    /* Power down sensors. The AHT20 (<1uA idle) stays up across a light
+     * sleep so its I2C device keeps working without a re-init. */
     gophr_sensor_power(false);
-    gophr_aht20_power(false);
+    if (!stay_joined) {
+        gophr_aht20_power(false);
+    }
 
     /* Turn off LED */
     gophr_led_off();
     gophr_led_power(false);
 
-    /* Wait 5 seconds for Zigbee attribute reports to propagate */
-    ESP_LOGI(TAG, "Waiting 5s for attribute propagation...");
-    vTaskDelay(pdMS_TO_TICKS(5000));
+    /* Send final reports and sleep as soon as the coordinator has them */
+    if (gophr_zigbee_flush_reports(GOPHR_ZB_FLUSH_TIMEOUT_MS, GOPHR_ZB_FLUSH_RETRIES) != ESP_OK) {
+        ESP_LOGW(TAG, "Not all reports confirmed, sleeping anyway");
+    }
 
     /* Final check: only sleep if still on the network */
     if (!gophr_zigbee_is_joined()) {
@@ -115,6 +263,20 @@ static void sleep_sequence(void)
         return;
     }
 
+    /* Still on the network: this sleep happens */
+    apply_plan(&plan);
+
+    /* Settings changed this session go to flash before the radio goes quiet */
+    gophr_persist_flush();
+
+    gophr_trace_mark(GOPHR_PHASE_SLEEP);
+    gophr_trace_emit();
+    gophr_energy_close_cycle(!stay_joined);
+
+    if (stay_joined) {
+        stay_joined_sleep();
+        return;
+    }
     enter_deep_sleep();
 }
 
@@ -129,15 +291,18 @@ void gophr_sleep_check(void)
     uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
     uint32_t awake_ms = now_ms - s_awake_start_ms;
     uint32_t max_awake_ms = (uint32_t)s_max_awake_min * 60U * 1000U;
-    uint32_t min_awake_ms = (uint32_t)s_min_awake_min * 60U * 1000U;
+    uint32_t min_awake_ms = (uint32_t)s_awake_window_min * 60U * 1000U;
 
     bool should_sleep = false;
 
+    /* An OTA download keeps the device awake, up to the max awake time */
     if (awake_ms > max_awake_ms) {
         ESP_LOGI(TAG, "Max awake time exceeded (%d min) - forcing sleep", s_max_awake_min);
         should_sleep = true;
+    } else if (gophr_ota_in_progress()) {
+        ESP_LOGD(TAG, "OTA download in progress - staying awake");
     } else if (awake_ms > min_awake_ms) {
-        ESP_LOGI(TAG, "Min awake reached (%d min) - going to sleep", s_min_awake_min);
+        ESP_LOGI(TAG, "Min awake reached (%d min) - going to sleep", s_awake_window_min);
         should_sleep = true;
     }
 
@@ -153,6 +318,10 @@ void gophr_sleep_now(void)
         return;
     }
     s_sleep_disabled = false;
+    if (gophr_ota_in_progress()) {
+        ESP_LOGI(TAG, "OTA download in progress - sleeping once it is done");
+        return;
+    }
     sleep_sequence();
 }
 
@@ -160,10 +329,13 @@ void gophr_sleep_now(void)
 
 int gophr_sleep_get_duration(void) { return s_sleep_duration_min; }
 
+int gophr_sleep_get_interval(void) { return s_interval_min; }
+
 void gophr_sleep_set_duration(int minutes)
 {
     if (minutes < 1 || minutes > 1440) return;
     s_sleep_duration_min = minutes;
+    s_interval_min = minutes;
     save_config();
     ESP_LOGI(TAG, "Sleep duration set to %d min", minutes);
 }
@@ -174,6 +346,7 @@ void gophr_sleep_set_min_awake(int minutes)
 {
     if (minutes < 0 || minutes > 15) return;
     s_min_awake_min = minutes;
+    s_awake_window_min = minutes;
     save_config();
     ESP_LOGI(TAG, "Min awake set to %d min", minutes);
 }
@@ -188,6 +361,28 @@ void gophr_sleep_set_max_awake(int minutes)
     ESP_LOGI(TAG, "Max awake set to %d min", minutes);
 }
 
+int gophr_sleep_get_min_interval(void) { return s_min_interval_min; }
+
+void gophr_sleep_set_min_interval(int minutes)
+{
+    if (minutes < 0 || minutes > 1440) return;
+    if (minutes && s_max_interval_min && minutes > s_max_interval_min) return;
+    s_min_interval_min = minutes;
+    save_config();
+    ESP_LOGI(TAG, "Min interval set to %d min", minutes);
+}
+
+int gophr_sleep_get_max_interval(void) { return s_max_interval_min; }
+
+void gophr_sleep_set_max_interval(int minutes)
+{
+    if (minutes < 0 || minutes > 1440) return;
+    if (minutes && minutes < s_min_interval_min) return;
+    s_max_interval_min = minutes;
+    save_config();
+    ESP_LOGI(TAG, "Max interval set to %d min", minutes);
+}
+
 bool gophr_sleep_is_disabled(void) { return s_sleep_disabled; }
 
 void gophr_sleep_set_disabled(bool disabled)
@@ -210,3 +405,35 @@ bool gophr_sleep_sequence_active(void)
 {
     return s_sleep_sequence_active;
 }
+
+bool gophr_sleep_is_warm_wake(void)
+{
+    return s_warm_wake;
+}
+
+uint32_t gophr_sleep_get_wake_count(void)
+{
+    return s_wake_count;
+}
+
+void gophr_sleep_skip_wake(void)
+{
+    sleep_plan_t plan = plan_next_sleep();
+    apply_plan(&plan);
+    uint64_t sleep_us = (uint64_t)s_interval_min * 60ULL * 1000000ULL;
+    ESP_LOGI(TAG, "Nothing to report, back to sleep for %d minutes", s_interval_min);
+
+    gophr_sensor_power(false);
+    gophr_aht20_power(false);
+    gophr_persist_flush();
+
+    gophr_trace_mark(GOPHR_PHASE_SKIP);
+    gophr_trace_emit();
+    gophr_energy_close_cycle(true);
+
+    /* Network state is as the last real sleep left it; re-arm the warm-wake path */
+    s_rtc_magic = SLEEP_RTC_MAGIC;
+
+    esp_sleep_enable_timer_wakeup(sleep_us);
+    esp_deep_sleep_start();
+}
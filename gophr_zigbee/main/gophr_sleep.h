@@ -8,6 +8,11 @@
 #define GOPHR_DEFAULT_MIN_AWAKE_MIN         1
 #define GOPHR_DEFAULT_MAX_AWAKE_MIN         120
 #define GOPHR_DEFAULT_SLEEP_DISABLED        true
+#define GOPHR_DEFAULT_MIN_INTERVAL_MIN      0       /* No user bound on the adapted interval */
+#define GOPHR_DEFAULT_MAX_INTERVAL_MIN      0
+
+/* Sleep durations up to this stay joined in light sleep instead of deep sleep */
+#define GOPHR_LIGHT_SLEEP_MAX_MIN           10
 
 /* Initialize sleep subsystem, load config from NVS */
 esp_err_t gophr_sleep_init(void);
@@ -22,12 +27,21 @@ void gophr_sleep_now(void);
 int gophr_sleep_get_duration(void);
 void gophr_sleep_set_duration(int minutes);
 
+/* Sleep interval actually used: the duration adapted to battery and solar (gophr_duty.h) */
+int gophr_sleep_get_interval(void);
+
 int gophr_sleep_get_min_awake(void);
 void gophr_sleep_set_min_awake(int minutes);
 
 int gophr_sleep_get_max_awake(void);
 void gophr_sleep_set_max_awake(int minutes);
 
+/* Bounds on the adapted interval (0 = none); a bound that would cross the other is rejected */
+int gophr_sleep_get_min_interval(void);
+void gophr_sleep_set_min_interval(int minutes);
+int gophr_sleep_get_max_interval(void);
+void gophr_sleep_set_max_interval(int minutes);
+
 bool gophr_sleep_is_disabled(void);
 void gophr_sleep_set_disabled(bool disabled);
 
@@ -36,3 +50,12 @@ uint32_t gophr_sleep_get_awake_seconds(void);
 
 /* Check if a sleep sequence is currently active */
 bool gophr_sleep_sequence_active(void);
+
+/* True if this boot is a timer wake from our own deep sleep (RTC state valid) */
+bool gophr_sleep_is_warm_wake(void);
+
+/* Consecutive warm wakes since the last cold boot */
+uint32_t gophr_sleep_get_wake_count(void);
+
+/* Warm wake with nothing to report: straight back to deep sleep, radio never started */
+void gophr_sleep_skip_wake(void);
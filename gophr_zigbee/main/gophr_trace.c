@@ -0,0 +1,112 @@
+#include "gophr_trace.h"
+
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+static const char *TAG = "gophr_trace";
+
+#define TRACE_RTC_MAGIC     0x47545231  /* "GTR1" */
+#define TRACE_NOT_REACHED   UINT32_MAX
+
+typedef struct {
+    uint32_t count;
+    uint32_t avg_ms;
+    uint32_t min_ms;
+    uint32_t max_ms;
+} trace_stat_t;
+
+static RTC_DATA_ATTR uint32_t s_rtc_magic;
+static RTC_DATA_ATTR uint32_t s_wakes;
+static RTC_DATA_ATTR uint32_t s_marks_ms[GOPHR_PHASE_COUNT];
+static RTC_DATA_ATTR trace_stat_t s_stats[GOPHR_PHASE_COUNT];
+
+static const char *const s_phase_names[GOPHR_PHASE_COUNT] = {
+    [GOPHR_PHASE_BOOT]      = "boot",
+    [GOPHR_PHASE_INIT]      = "init",
+    [GOPHR_PHASE_STACK]     = "stack",
+    [GOPHR_PHASE_JOINED]    = "joined",
+    [GOPHR_PHASE_REPORT]    = "report",
+    [GOPHR_PHASE_SLEEP_SEQ] = "sleepseq",
+    [GOPHR_PHASE_SLEEP]     = "sleep",
+    [GOPHR_PHASE_SKIP]      = "skip",
+};
+
+static int64_t s_origin_us;
+static bool s_started;
+static bool s_emitted;
+
+void gophr_trace_start(void)
+{
+    if (s_rtc_magic != TRACE_RTC_MAGIC) {
+        for (int p = 0; p < GOPHR_PHASE_COUNT; p++) {
+            s_stats[p] = (trace_stat_t){ .min_ms = UINT32_MAX };
+        }
+        s_wakes = 0;
+        s_rtc_magic = TRACE_RTC_MAGIC;
+    }
+
+    /* After boot, esp_timer already counts from reset; after a light sleep, start over */
+    s_origin_us = s_started ? esp_timer_get_time() : 0;
+    s_started = true;
+    s_emitted = false;
+    s_wakes++;
+
+    for (int p = 0; p < GOPHR_PHASE_COUNT; p++) {
+        s_marks_ms[p] = TRACE_NOT_REACHED;
+    }
+}
+
+void gophr_trace_mark(gophr_phase_t phase)
+{
+    if (!s_started || phase >= GOPHR_PHASE_COUNT) return;
+    if (s_marks_ms[phase] != TRACE_NOT_REACHED) return;
+    s_marks_ms[phase] = (uint32_t)((esp_timer_get_time() - s_origin_us) / 1000);
+}
+
+static void fold(trace_stat_t *st, uint32_t ms)
+{
+    if (st->count == 0) {
+        st->avg_ms = ms;
+    } else {
+        st->avg_ms = (uint32_t)((int32_t)st->avg_ms + ((int32_t)ms - (int32_t)st->avg_ms) / GOPHR_TRACE_AVG_WEIGHT);
+    }
+    if (ms < st->min_ms) st->min_ms = ms;
+    if (ms > st->max_ms) st->max_ms = ms;
+    st->count++;
+}
+
+void gophr_trace_emit(void)
+{
+    if (!s_started || s_emitted) return;
+    s_emitted = true;
+
+    char line[320];
+    int len = snprintf(line, sizeof(line), "GTRACE v1 wake=%lu", (unsigned long)s_wakes);
+
+    for (int p = 0; p < GOPHR_PHASE_COUNT && len < (int)sizeof(line); p++) {
+        trace_stat_t *st = &s_stats[p];
+        uint32_t ms = s_marks_ms[p];
+
+        if (ms != TRACE_NOT_REACHED) {
+            fold(st, ms);
+            len += snprintf(line + len, sizeof(line) - len, " %s=%lu", s_phase_names[p], (unsigned long)ms);
+        } else {
+            len += snprintf(line + len, sizeof(line) - len, " %s=-", s_phase_names[p]);
+        }
+        if (len >= (int)sizeof(line)) break;
+
+        if (st->count) {
+            len += snprintf(line + len, sizeof(line) - len, ",%lu,%lu,%lu",
+                            (unsigned long)st->avg_ms, (unsigned long)st->min_ms,
+                            (unsigned long)st->max_ms);
+        } else {
+            len += snprintf(line + len, sizeof(line) - len, ",-,-,-");
+        }
+    }
+
+    ESP_LOGI(TAG, "%s", line);
+}
@@ -1,8 +1,14 @@
 #include "gophr_zigbee.h"
 #include "gophr_drivers.h"
+#include "gophr_ota.h"
+#include "gophr_trace.h"
 
 #include "esp_log.h"
 #include "esp_check.h"
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "ha/esp_zigbee_ha_standard.h"
 
 static const char *TAG = "gophr_zigbee";
@@ -20,9 +26,50 @@ static uint16_t percent_to_zigbee_humidity(float pct)
     return (uint16_t)(pct * 100.0f);
 }
 
-/* ---------- Create Endpoints & Clusters ---------- */
+/* Delivery callbacks, defined with the report flush below */
+static void report_confirm_cb(esp_zb_apsde_data_confirm_t confirm);
+static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message);
 
-static esp_zb_cluster_list_t *create_temperature_endpoint_clusters(void)
+/* ---------- Create Endpoint & Clusters ---------- */
+
+/*
+ * Gophr Soil cluster: every measured value, so one report frame carries them
+ * all. The attributes are not reportable through the stack: a coordinator
+ * configuring reporting would get one frame per attribute again.
+ */
+static esp_zb_attribute_list_t *create_soil_cluster(void)
+{
+    esp_zb_attribute_list_t *soil_cluster = esp_zb_zcl_attr_list_create(GOPHR_CLUSTER_ID_SOIL);
+    const uint8_t access = ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY;
+
+    uint16_t moisture = percent_to_zigbee_humidity(0.0f);
+    const uint16_t moisture_ids[] = {GOPHR_ATTR_SOIL_MOISTURE_1, GOPHR_ATTR_SOIL_MOISTURE_2,
+                                     GOPHR_ATTR_SOIL_MOISTURE_3};
+    for (int i = 0; i < 3; i++) {
+        ESP_ERROR_CHECK(esp_zb_custom_cluster_add_custom_attr(soil_cluster, moisture_ids[i],
+            ESP_ZB_ZCL_ATTR_TYPE_U16, access, &moisture));
+    }
+
+    int16_t temperature = celsius_to_zigbee(25.0f);
+    ESP_ERROR_CHECK(esp_zb_custom_cluster_add_custom_attr(soil_cluster, GOPHR_ATTR_SOIL_TEMPERATURE,
+        ESP_ZB_ZCL_ATTR_TYPE_S16, access, &temperature));
+
+    uint16_t humidity = percent_to_zigbee_humidity(50.0f);
+    ESP_ERROR_CHECK(esp_zb_custom_cluster_add_custom_attr(soil_cluster, GOPHR_ATTR_SOIL_HUMIDITY,
+        ESP_ZB_ZCL_ATTR_TYPE_U16, access, &humidity));
+
+    uint32_t energy = 0;
+    const uint16_t energy_ids[] = {GOPHR_ATTR_ENERGY_CYCLE, GOPHR_ATTR_ENERGY_TODAY,
+                                   GOPHR_ATTR_ENERGY_DAY};
+    for (int i = 0; i < 3; i++) {
+        ESP_ERROR_CHECK(esp_zb_custom_cluster_add_custom_attr(soil_cluster, energy_ids[i],
+            ESP_ZB_ZCL_ATTR_TYPE_U32, access, &energy));
+    }
+
+    return soil_cluster;
+}
+
+static esp_zb_cluster_list_t *create_endpoint_clusters(void)
 {
     esp_zb_cluster_list_t *cluster_list = esp_zb_zcl_cluster_list_create();
 
@@ -46,15 +93,6 @@ static esp_zb_cluster_list_t *create_temperature_endpoint_clusters(void)
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_identify_cluster(cluster_list,
         esp_zb_identify_cluster_create(&identify_cfg), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
 
-    /* Temperature measurement cluster */
-    esp_zb_temperature_meas_cluster_cfg_t temp_cfg = {
-        .measured_value = celsius_to_zigbee(25.0f),
-        .min_value = celsius_to_zigbee(-10.0f),
-        .max_value = celsius_to_zigbee(80.0f),
-    };
-    ESP_ERROR_CHECK(esp_zb_cluster_list_add_temperature_meas_cluster(cluster_list,
-        esp_zb_temperature_meas_cluster_create(&temp_cfg), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
-
     /* Power configuration cluster */
     esp_zb_power_config_cluster_cfg_t power_cfg = {0};
     esp_zb_attribute_list_t *power_cluster = esp_zb_power_config_cluster_create(&power_cfg);
@@ -72,226 +110,470 @@ static esp_zb_cluster_list_t *create_temperature_endpoint_clusters(void)
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_power_config_cluster(cluster_list,
         power_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
 
+    /* Gophr Soil cluster (moisture 1-3, temperature, humidity) */
+    ESP_ERROR_CHECK(esp_zb_cluster_list_add_custom_cluster(cluster_list,
+        create_soil_cluster(), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+
+    /* OTA Upgrade client */
+    ESP_ERROR_CHECK(gophr_ota_add_cluster(cluster_list));
+
     return cluster_list;
 }
 
-static esp_zb_cluster_list_t *create_humidity_endpoint_clusters(void)
+esp_err_t gophr_zigbee_create_device(void)
 {
-    esp_zb_cluster_list_t *cluster_list = esp_zb_zcl_cluster_list_create();
+    esp_zb_ep_list_t *ep_list = esp_zb_ep_list_create();
 
-    /* Basic cluster (minimal) */
-    esp_zb_basic_cluster_cfg_t basic_cfg = {
-        .zcl_version = ESP_ZB_ZCL_BASIC_ZCL_VERSION_DEFAULT_VALUE,
-        .power_source = 0x03,
+    esp_zb_endpoint_config_t ep_cfg = {
+        .endpoint = GOPHR_EP,
+        .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .app_device_id = ESP_ZB_HA_SIMPLE_SENSOR_DEVICE_ID,
+        .app_device_version = 0,
     };
-    ESP_ERROR_CHECK(esp_zb_cluster_list_add_basic_cluster(cluster_list,
-        esp_zb_basic_cluster_create(&basic_cfg), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+    esp_zb_ep_list_add_ep(ep_list, create_endpoint_clusters(), ep_cfg);
 
-    /* Identify cluster */
-    esp_zb_identify_cluster_cfg_t identify_cfg = {.identify_time = 0};
-    ESP_ERROR_CHECK(esp_zb_cluster_list_add_identify_cluster(cluster_list,
-        esp_zb_identify_cluster_create(&identify_cfg), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+    /* Register device */
+    esp_zb_device_register(ep_list);
 
-    /* Humidity measurement cluster */
-    esp_zb_humidity_meas_cluster_cfg_t hum_cfg = {
-        .measured_value = percent_to_zigbee_humidity(50.0f),
-        .min_value = percent_to_zigbee_humidity(0.0f),
-        .max_value = percent_to_zigbee_humidity(100.0f),
-    };
-    ESP_ERROR_CHECK(esp_zb_cluster_list_add_humidity_meas_cluster(cluster_list,
-        esp_zb_humidity_meas_cluster_create(&hum_cfg), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+    /* Delivery tracking for gophr_zigbee_flush_reports() */
+    esp_zb_core_action_handler_register(zb_action_handler);
+    esp_zb_aps_data_confirm_handler_register(report_confirm_cb);
 
-    return cluster_list;
+    ESP_LOGI(TAG, "Zigbee device registered (1 endpoint, soil cluster 0x%04x)", GOPHR_CLUSTER_ID_SOIL);
+    return ESP_OK;
 }
 
-esp_err_t gophr_zigbee_create_device(void)
+/* ---------- Staged Attribute Commit ---------- */
+
+typedef enum {
+    ATTR_TEMPERATURE = 0,
+    ATTR_HUMIDITY,
+    ATTR_MOISTURE_1,
+    ATTR_MOISTURE_2,
+    ATTR_MOISTURE_3,
+    ATTR_BATTERY_VOLTAGE,
+    ATTR_BATTERY_PERCENT,
+    ATTR_ENERGY_CYCLE,
+    ATTR_ENERGY_TODAY,
+    ATTR_ENERGY_DAY,
+    ATTR_COUNT,
+} staged_attr_t;
+
+typedef struct {
+    uint8_t ep;
+    uint16_t cluster_id;
+    uint16_t attr_id;
+    uint8_t size;       /* Bytes of the ZCL value (uint32/int16/uint16/uint8) */
+} attr_desc_t;
+
+static const attr_desc_t s_attr_desc[ATTR_COUNT] = {
+    [ATTR_TEMPERATURE] = {GOPHR_EP, GOPHR_CLUSTER_ID_SOIL, GOPHR_ATTR_SOIL_TEMPERATURE, sizeof(int16_t)},
+    [ATTR_HUMIDITY] = {GOPHR_EP, GOPHR_CLUSTER_ID_SOIL, GOPHR_ATTR_SOIL_HUMIDITY, sizeof(uint16_t)},
+    [ATTR_MOISTURE_1] = {GOPHR_EP, GOPHR_CLUSTER_ID_SOIL, GOPHR_ATTR_SOIL_MOISTURE_1, sizeof(uint16_t)},
+    [ATTR_MOISTURE_2] = {GOPHR_EP, GOPHR_CLUSTER_ID_SOIL, GOPHR_ATTR_SOIL_MOISTURE_2, sizeof(uint16_t)},
+    [ATTR_MOISTURE_3] = {GOPHR_EP, GOPHR_CLUSTER_ID_SOIL, GOPHR_ATTR_SOIL_MOISTURE_3, sizeof(uint16_t)},
+    [ATTR_BATTERY_VOLTAGE] = {GOPHR_EP, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
+                              ESP_ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_VOLTAGE_ID, sizeof(uint8_t)},
+    [ATTR_BATTERY_PERCENT] = {GOPHR_EP, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
+                              ESP_ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_PERCENTAGE_REMAINING_ID, sizeof(uint8_t)},
+    [ATTR_ENERGY_CYCLE] = {GOPHR_EP, GOPHR_CLUSTER_ID_SOIL, GOPHR_ATTR_ENERGY_CYCLE, sizeof(uint32_t)},
+    [ATTR_ENERGY_TODAY] = {GOPHR_EP, GOPHR_CLUSTER_ID_SOIL, GOPHR_ATTR_ENERGY_TODAY, sizeof(uint32_t)},
+    [ATTR_ENERGY_DAY] = {GOPHR_EP, GOPHR_CLUSTER_ID_SOIL, GOPHR_ATTR_ENERGY_DAY, sizeof(uint32_t)},
+};
+
+/* Staged values and the values last written to the stack (sensor task only) */
+static int32_t s_staged[ATTR_COUNT];
+static int32_t s_written[ATTR_COUNT];
+static uint32_t s_staged_mask = 0;
+static uint32_t s_written_mask = 0;
+
+static void stage(staged_attr_t attr, int32_t value)
 {
-    esp_zb_ep_list_t *ep_list = esp_zb_ep_list_create();
+    s_staged[attr] = value;
+    s_staged_mask |= 1U << attr;
+}
 
-    /* Endpoint 1: Temperature + Power Config */
-    esp_zb_endpoint_config_t temp_ep_cfg = {
-        .endpoint = GOPHR_EP_TEMP,
-        .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID,
-        .app_device_id = ESP_ZB_HA_TEMPERATURE_SENSOR_DEVICE_ID,
-        .app_device_version = 0,
-    };
-    esp_zb_ep_list_add_ep(ep_list, create_temperature_endpoint_clusters(), temp_ep_cfg);
+void gophr_zigbee_stage_temperature(float celsius)
+{
+    stage(ATTR_TEMPERATURE, celsius_to_zigbee(celsius));
+}
 
-    /* Endpoint 2: AHT20 Humidity */
-    esp_zb_endpoint_config_t hum_ep_cfg = {
-        .endpoint = GOPHR_EP_HUMIDITY,
-        .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID,
-        .app_device_id = ESP_ZB_HA_CUSTOM_ATTR_DEVICE_ID,
-        .app_device_version = 0,
-    };
-    esp_zb_ep_list_add_ep(ep_list, create_humidity_endpoint_clusters(), hum_ep_cfg);
+void gophr_zigbee_stage_humidity(float percent)
+{
+    stage(ATTR_HUMIDITY, percent_to_zigbee_humidity(percent));
+}
 
-    /* Endpoints 3-5: Soil Moisture (as humidity %) */
-    uint8_t moisture_eps[] = {GOPHR_EP_MOISTURE_1, GOPHR_EP_MOISTURE_2, GOPHR_EP_MOISTURE_3};
-    for (int i = 0; i < 3; i++) {
-        esp_zb_endpoint_config_t moist_ep_cfg = {
-            .endpoint = moisture_eps[i],
-            .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID,
-            .app_device_id = ESP_ZB_HA_CUSTOM_ATTR_DEVICE_ID,
-            .app_device_version = 0,
-        };
-        esp_zb_ep_list_add_ep(ep_list, create_humidity_endpoint_clusters(), moist_ep_cfg);
+void gophr_zigbee_stage_moisture(int sensor_index, float percent)
+{
+    if (sensor_index < 0 || sensor_index >= 3) return;
+    stage(ATTR_MOISTURE_1 + sensor_index, percent_to_zigbee_humidity(percent));
+}
+
+void gophr_zigbee_stage_battery(float voltage, float percent)
+{
+    /* Battery voltage in 100mV units */
+    stage(ATTR_BATTERY_VOLTAGE, (uint8_t)(voltage * 10.0f));
+    /* Battery percentage in half-percent units (200 = 100%) */
+    stage(ATTR_BATTERY_PERCENT, (uint8_t)(percent * 2.0f));
+}
+
+void gophr_zigbee_stage_energy(const gophr_energy_summary_t *energy)
+{
+    stage(ATTR_ENERGY_CYCLE, (int32_t)energy->cycle_uah);
+    stage(ATTR_ENERGY_TODAY, (int32_t)energy->today_uah);
+    stage(ATTR_ENERGY_DAY, (int32_t)energy->day_uah);
+}
+
+int gophr_zigbee_commit(void)
+{
+    /* Drop staged values that match what the stack already holds */
+    uint32_t dirty = 0;
+    for (int a = 0; a < ATTR_COUNT; a++) {
+        uint32_t bit = 1U << a;
+        if (!(s_staged_mask & bit)) continue;
+        if ((s_written_mask & bit) && s_written[a] == s_staged[a]) continue;
+        dirty |= bit;
     }
+    s_staged_mask = 0;
+    if (!dirty) return 0;
 
-    /* Register device */
-    esp_zb_device_register(ep_list);
+    int written = 0;
+    esp_zb_lock_acquire(portMAX_DELAY);
+    for (int a = 0; a < ATTR_COUNT; a++) {
+        if (!(dirty & (1U << a))) continue;
+
+        const attr_desc_t *d = &s_attr_desc[a];
+        uint32_t v32 = (uint32_t)s_staged[a];
+        uint16_t v16 = (uint16_t)s_staged[a];   /* Same bytes for int16 and uint16 */
+        uint8_t v8 = (uint8_t)s_staged[a];
+        void *value = d->size == sizeof(uint32_t) ? (void *)&v32 :
+                      d->size == sizeof(uint16_t) ? (void *)&v16 : (void *)&v8;
+        esp_zb_zcl_status_t status = esp_zb_zcl_set_attribute_val(d->ep, d->cluster_id,
+                                                                  ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                                                  d->attr_id, value, false);
+        if (status != ESP_ZB_ZCL_STATUS_SUCCESS) {
+            /* Left unmarked so the next commit of the same value retries it */
+            ESP_LOGW(TAG, "Attribute 0x%04x write failed (status 0x%02x)", d->attr_id, status);
+            dirty &= ~(1U << a);
+            continue;
+        }
+        s_written[a] = s_staged[a];
+        written++;
+    }
+    esp_zb_lock_release();
 
-    /* Configure reporting for temperature */
-    esp_zb_zcl_reporting_info_t temp_report = {
-        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV,
-        .ep = GOPHR_EP_TEMP,
-        .cluster_id = ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
-        .cluster_role = ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-        .dst.profile_id = ESP_ZB_AF_HA_PROFILE_ID,
-        .u.send_info.min_interval = GOPHR_REPORT_MIN_INTERVAL,
-        .u.send_info.max_interval = GOPHR_REPORT_MAX_INTERVAL,
-        .u.send_info.def_min_interval = GOPHR_REPORT_MIN_INTERVAL,
-        .u.send_info.def_max_interval = GOPHR_REPORT_MAX_INTERVAL,
-        .u.send_info.delta.u16 = GOPHR_TEMP_REPORT_DELTA,
-        .attr_id = ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID,
-        .manuf_code = ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC,
-    };
-    esp_zb_zcl_update_reporting_info(&temp_report);
-
-    /* Configure reporting for humidity (endpoint 2) */
-    esp_zb_zcl_reporting_info_t hum_report = {
-        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV,
-        .ep = GOPHR_EP_HUMIDITY,
-        .cluster_id = ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT,
-        .cluster_role = ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-        .dst.profile_id = ESP_ZB_AF_HA_PROFILE_ID,
-        .u.send_info.min_interval = GOPHR_REPORT_MIN_INTERVAL,
-        .u.send_info.max_interval = GOPHR_REPORT_MAX_INTERVAL,
-        .u.send_info.def_min_interval = GOPHR_REPORT_MIN_INTERVAL,
-        .u.send_info.def_max_interval = GOPHR_REPORT_MAX_INTERVAL,
-        .u.send_info.delta.u16 = GOPHR_HUMIDITY_REPORT_DELTA,
-        .attr_id = ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID,
-        .manuf_code = ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC,
+    s_written_mask |= dirty;
+    if (s_joined) {
+        gophr_trace_mark(GOPHR_PHASE_REPORT);
+    }
+    ESP_LOGD(TAG, "Committed %d attribute(s)", written);
+    return written;
+}
+
+/* ---------- Aggregated Report ---------- */
+
+/* Soil cluster attributes carried by the aggregated report, in frame order */
+static const uint16_t s_report_attrs[] = {
+    GOPHR_ATTR_SOIL_MOISTURE_1,
+    GOPHR_ATTR_SOIL_MOISTURE_2,
+    GOPHR_ATTR_SOIL_MOISTURE_3,
+    GOPHR_ATTR_SOIL_TEMPERATURE,
+    GOPHR_ATTR_SOIL_HUMIDITY,
+};
+#define REPORT_ATTR_COUNT   (sizeof(s_report_attrs) / sizeof(s_report_attrs[0]))
+
+/* Staged values behind s_report_attrs, with the change that warrants a new report */
+static const struct {
+    staged_attr_t attr;
+    int32_t delta;
+} s_report_deltas[] = {
+    {ATTR_MOISTURE_1, GOPHR_HUMIDITY_REPORT_DELTA},
+    {ATTR_MOISTURE_2, GOPHR_HUMIDITY_REPORT_DELTA},
+    {ATTR_MOISTURE_3, GOPHR_HUMIDITY_REPORT_DELTA},
+    {ATTR_TEMPERATURE, GOPHR_TEMP_REPORT_DELTA},
+    {ATTR_HUMIDITY, GOPHR_HUMIDITY_REPORT_DELTA},
+};
+
+/* Values carried by the last aggregated report (sensor task only) */
+static int32_t s_reported[REPORT_ATTR_COUNT];
+static bool s_reported_valid = false;
+static bool s_reported_confirmed = false;   /* ... and the coordinator has them */
+
+/* ZCL header (5) + per attribute: id (2), type (1), 16-bit value (2) */
+#define REPORT_FRAME_MAX    (5 + REPORT_ATTR_COUNT * 5)
+
+#define ZCL_FC_CLUSTER_SPECIFIC     0x01
+#define ZCL_FC_MANUF_SPECIFIC       0x04
+#define ZCL_FC_TO_CLIENT            0x08
+#define ZCL_CMD_REPORT_ATTRIBUTES   0x0a
+#define ZCL_HDR_LEN                 5   /* Frame control, manufacturer code, TSN, command */
+#define ZCL_HDR_TSN_OFFSET          3   /* After frame control + manufacturer code */
+
+static uint8_t s_report_tsn_counter = 0;
+
+/* Start a manufacturer-specific soil cluster frame to the client; returns the TSN */
+static uint8_t put_zcl_header(uint8_t *frame, uint8_t frame_control, uint8_t command)
+{
+    uint8_t tsn = s_report_tsn_counter++;
+    frame[0] = frame_control | ZCL_FC_MANUF_SPECIFIC | ZCL_FC_TO_CLIENT; /* Default response enabled */
+    frame[1] = GOPHR_MANUFACTURER_CODE & 0xff;
+    frame[2] = GOPHR_MANUFACTURER_CODE >> 8;
+    frame[3] = tsn;
+    frame[4] = command;
+    return tsn;
+}
+
+/* Hand a soil cluster frame to APS for the coordinator, with ack requested */
+static void send_frame(uint8_t *frame, size_t len)
+{
+    esp_zb_apsde_data_req_t req = {
+        .dst_addr_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .dst_addr.addr_short = GOPHR_REPORT_DST_ADDR,
+        .dst_endpoint = GOPHR_REPORT_DST_EP,
+        .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .cluster_id = GOPHR_CLUSTER_ID_SOIL,
+        .src_endpoint = GOPHR_EP,
+        .asdu_length = len,
+        .asdu = frame,
+        .tx_options = ESP_ZB_APSDE_TX_OPT_ACK_TX,
+        .radius = 0,
     };
-    esp_zb_zcl_update_reporting_info(&hum_report);
+    esp_err_t err = esp_zb_aps_data_request(&req);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "APS data request failed: %s", esp_err_to_name(err));
+    }
+}
 
-    /* Configure reporting for each moisture endpoint */
-    for (int i = 0; i < 3; i++) {
-        esp_zb_zcl_reporting_info_t moist_report = {
-            .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV,
-            .ep = moisture_eps[i],
-            .cluster_id = ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT,
-            .cluster_role = ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-            .dst.profile_id = ESP_ZB_AF_HA_PROFILE_ID,
-            .u.send_info.min_interval = GOPHR_REPORT_MIN_INTERVAL,
-            .u.send_info.max_interval = GOPHR_REPORT_MAX_INTERVAL,
-            .u.send_info.def_min_interval = GOPHR_REPORT_MIN_INTERVAL,
-            .u.send_info.def_max_interval = GOPHR_REPORT_MAX_INTERVAL,
-            .u.send_info.delta.u16 = GOPHR_HUMIDITY_REPORT_DELTA,
-            .attr_id = ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID,
-            .manuf_code = ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC,
-        };
-        esp_zb_zcl_update_reporting_info(&moist_report);
+/*
+ * Build one manufacturer-specific Report Attributes frame with every soil
+ * cluster value and hand it to APS with ack requested. The ZCL report API
+ * only sends one attribute per frame, so the frame is assembled here.
+ * Caller holds the stack lock; returns the frame's ZCL TSN.
+ */
+static uint8_t send_report(void)
+{
+    uint8_t frame[REPORT_FRAME_MAX];
+    uint8_t tsn = put_zcl_header(frame, 0, ZCL_CMD_REPORT_ATTRIBUTES);
+    size_t len = ZCL_HDR_LEN;
+
+    for (size_t i = 0; i < REPORT_ATTR_COUNT; i++) {
+        esp_zb_zcl_attr_t *attr = esp_zb_zcl_get_attribute(GOPHR_EP, GOPHR_CLUSTER_ID_SOIL,
+                                                           ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, s_report_attrs[i]);
+        if (!attr || !attr->data_p) continue;
+
+        const uint8_t *value = attr->data_p;
+        frame[len++] = s_report_attrs[i] & 0xff;
+        frame[len++] = s_report_attrs[i] >> 8;
+        frame[len++] = attr->type;
+        frame[len++] = value[0];    /* All soil attributes are 16-bit, little-endian */
+        frame[len++] = value[1];
     }
 
-    ESP_LOGI(TAG, "Zigbee device registered with 5 endpoints");
-    return ESP_OK;
+    for (size_t i = 0; i < REPORT_ATTR_COUNT; i++) {
+        s_reported[i] = s_written[s_report_deltas[i].attr];
+    }
+    s_reported_valid = true;
+    s_reported_confirmed = false;
+
+    send_frame(frame, len);
+    return tsn;
 }
 
-/* ---------- Attribute Updates ---------- */
+/* ---------- Backlog ---------- */
+
+#define BACKLOG_PAYLOAD_MAX (GOPHR_BACKLOG_HEADER_LEN + GOPHR_ZB_BACKLOG_PER_FRAME * GOPHR_SAMPLE_PACKED_LEN)
 
-void gophr_zigbee_update_temperature(float celsius)
+/* Payload of the backlog frame being delivered (sensor task only) */
+static uint8_t s_backlog_payload[BACKLOG_PAYLOAD_MAX];
+static size_t s_backlog_len;
+
+/* (Re)send the pending backlog payload under a fresh TSN. Caller holds the stack lock. */
+static uint8_t send_backlog(void)
 {
-    int16_t val = celsius_to_zigbee(celsius);
-    esp_zb_lock_acquire(portMAX_DELAY);
-    esp_zb_zcl_set_attribute_val(GOPHR_EP_TEMP,
-        ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
-        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-        ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID,
-        &val, false);
-    esp_zb_lock_release();
+    uint8_t frame[ZCL_HDR_LEN + BACKLOG_PAYLOAD_MAX];
+    uint8_t tsn = put_zcl_header(frame, ZCL_FC_CLUSTER_SPECIFIC, GOPHR_CMD_SOIL_BACKLOG);
+    memcpy(frame + ZCL_HDR_LEN, s_backlog_payload, s_backlog_len);
+    send_frame(frame, ZCL_HDR_LEN + s_backlog_len);
+    return tsn;
 }
 
-void gophr_zigbee_update_humidity(float percent)
+/* ---------- Report Flush ---------- */
+
+/*
+ * Delivery state of the frame in the current flush (aggregated report or
+ * backlog). Updated from the APS data confirm and default-response
+ * callbacks, which run with the stack lock held; the flushing task only
+ * touches it under the same lock.
+ */
+typedef enum {
+    REPORT_IDLE = 0,
+    REPORT_PENDING,     /* Sent, waiting for the APS ack */
+    REPORT_FAILED,      /* APS delivery failed, resend */
+    REPORT_ACKED,       /* APS ack received, waiting for the default response */
+    REPORT_CONFIRMED,   /* Default response received */
+} report_state_t;
+
+static report_state_t s_report_state = REPORT_IDLE;
+static uint8_t s_report_tsn;
+static TaskHandle_t s_flush_task = NULL;
+
+static bool is_flushed_report(uint8_t tsn)
 {
-    uint16_t val = percent_to_zigbee_humidity(percent);
-    esp_zb_lock_acquire(portMAX_DELAY);
-    esp_zb_zcl_set_attribute_val(GOPHR_EP_HUMIDITY,
-        ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT,
-        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-        ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID,
-        &val, false);
-    esp_zb_lock_release();
+    return s_flush_task && s_report_state != REPORT_IDLE && s_report_tsn == tsn;
 }
 
-void gophr_zigbee_update_moisture(int sensor_index, float percent)
+static void report_confirm_cb(esp_zb_apsde_data_confirm_t confirm)
 {
-    if (sensor_index < 0 || sensor_index >= 3) return;
+    if (confirm.src_endpoint != GOPHR_EP || !confirm.asdu ||
+        confirm.asdu_length <= ZCL_HDR_TSN_OFFSET) return;
+    if (!is_flushed_report(confirm.asdu[ZCL_HDR_TSN_OFFSET]) || s_report_state != REPORT_PENDING) return;
 
-    uint8_t ep = GOPHR_EP_MOISTURE_1 + sensor_index;
-    uint16_t val = percent_to_zigbee_humidity(percent);
+    s_report_state = (confirm.status == 0) ? REPORT_ACKED : REPORT_FAILED;
+    xTaskNotifyGive(s_flush_task);
+}
 
-    esp_zb_lock_acquire(portMAX_DELAY);
-    esp_zb_zcl_set_attribute_val(ep,
-        ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT,
-        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-        ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID,
-        &val, false);
-    esp_zb_lock_release();
+static void report_default_resp_cb(const esp_zb_zcl_cmd_default_resp_message_t *message)
+{
+    if (message->info.cluster != GOPHR_CLUSTER_ID_SOIL) return;
+    if (!is_flushed_report(message->info.header.tsn)) return;
+
+    /* A default response also implies the APS ack we may not have seen yet */
+    s_report_state = (message->status_code == ESP_ZB_ZCL_STATUS_SUCCESS) ? REPORT_CONFIRMED
+                                                                        : REPORT_FAILED;
+    xTaskNotifyGive(s_flush_task);
 }
 
-void gophr_zigbee_update_battery(float voltage, float percent)
+static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id, const void *message)
 {
-    /* Battery voltage in 100mV units */
-    uint8_t bat_v = (uint8_t)(voltage * 10.0f);
-    /* Battery percentage in half-percent units (200 = 100%) */
-    uint8_t bat_pct = (uint8_t)(percent * 2.0f);
+    switch (callback_id) {
+    case ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID:
+        report_default_resp_cb((const esp_zb_zcl_cmd_default_resp_message_t *)message);
+        break;
+    case ESP_ZB_CORE_OTA_UPGRADE_VALUE_CB_ID:
+        return gophr_ota_upgrade_cb((const esp_zb_zcl_ota_upgrade_value_message_t *)message);
+    default:
+        ESP_LOGD(TAG, "Unhandled action callback 0x%x", callback_id);
+        break;
+    }
+    return ESP_OK;
+}
+
+/*
+ * Send a frame with `send` and block until it is confirmed, resending a
+ * lost one up to `retries` times within `timeout_ms`.
+ */
+static esp_err_t deliver(uint8_t (*send)(void), const char *what, uint32_t timeout_ms, int retries)
+{
+    if (!s_joined) return ESP_ERR_INVALID_STATE;
+
+    uint32_t start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t attempt_ms = timeout_ms / (uint32_t)(retries + 1);
+    uint32_t sent_ms = start_ms;
+    uint32_t acked_ms = 0;
+    int sends = 1;
+
+    esp_zb_lock_acquire(portMAX_DELAY);
+    s_flush_task = xTaskGetCurrentTaskHandle();
+    s_report_tsn = send();
+    s_report_state = REPORT_PENDING;
+    esp_zb_lock_release();
+
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(GOPHR_ZB_FLUSH_POLL_MS));
+        uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+        esp_zb_lock_acquire(portMAX_DELAY);
+        /* Resend a failed frame right away, a silent one once its attempt expires */
+        bool lost = s_report_state == REPORT_FAILED ||
+                    (s_report_state == REPORT_PENDING && now_ms - sent_ms >= attempt_ms);
+        if (lost && sends <= retries) {
+            s_report_tsn = send();
+            s_report_state = REPORT_PENDING;
+            sent_ms = now_ms;
+            sends++;
+        }
+        report_state_t state = s_report_state;
+        esp_zb_lock_release();
+
+        if (state == REPORT_CONFIRMED) {
+            ret = ESP_OK;
+            break;
+        }
+        /* Reached the coordinator; give the default response a short grace period */
+        if (state == REPORT_ACKED) {
+            if (!acked_ms) acked_ms = now_ms;
+            if (now_ms - acked_ms >= GOPHR_ZB_FLUSH_RSP_GRACE_MS) {
+                ret = ESP_OK;
+                break;
+            }
+        }
+        /* Out of retries, or out of time */
+        if (state == REPORT_FAILED || now_ms - start_ms >= timeout_ms) {
+            ESP_LOGW(TAG, "%s not confirmed after %d send(s)", what, sends);
+            break;
+        }
+    }
 
     esp_zb_lock_acquire(portMAX_DELAY);
-    esp_zb_zcl_set_attribute_val(GOPHR_EP_TEMP,
-        ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-        ESP_ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_VOLTAGE_ID,
-        &bat_v, false);
-    esp_zb_zcl_set_attribute_val(GOPHR_EP_TEMP,
-        ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-        ESP_ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_PERCENTAGE_REMAINING_ID,
-        &bat_pct, false);
+    s_flush_task = NULL;
+    s_report_state = REPORT_IDLE;
     esp_zb_lock_release();
+
+    ESP_LOGI(TAG, "Flushed %s in %lums (%d send(s))", what,
+             (unsigned long)(xTaskGetTickCount() * portTICK_PERIOD_MS - start_ms), sends);
+    return ret;
 }
 
-void gophr_zigbee_report_all(void)
+/* Some reported value moved by more than `slack` times its report delta */
+static bool report_moved(int slack)
 {
-    /* Report temperature */
-    esp_zb_zcl_report_attr_cmd_t report = {0};
-    report.address_mode = ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT;
-    report.direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI;
+    if (!s_reported_valid) return true;
+    for (size_t i = 0; i < REPORT_ATTR_COUNT; i++) {
+        int32_t diff = s_written[s_report_deltas[i].attr] - s_reported[i];
+        int32_t band = s_report_deltas[i].delta * slack;
+        if (diff > band || -diff > band) return true;
+    }
+    return false;
+}
 
-    esp_zb_lock_acquire(portMAX_DELAY);
+static esp_err_t deliver_report(uint32_t timeout_ms, int retries)
+{
+    esp_err_t ret = deliver(send_report, "report", timeout_ms, retries);
+    s_reported_confirmed = ret == ESP_OK;
+    return ret;
+}
 
-    /* Temperature */
-    report.zcl_basic_cmd.src_endpoint = GOPHR_EP_TEMP;
-    report.clusterID = ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT;
-    report.attributeID = ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID;
-    esp_zb_zcl_report_attr_cmd_req(&report);
+bool gophr_zigbee_report_changed(void)
+{
+    if (!s_joined || !report_moved(1)) return false;
 
-    /* Humidity */
-    report.zcl_basic_cmd.src_endpoint = GOPHR_EP_HUMIDITY;
-    report.clusterID = ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT;
-    report.attributeID = ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID;
-    esp_zb_zcl_report_attr_cmd_req(&report);
+    /* Not confirmed: forget the baseline so the next call sends again */
+    if (deliver_report(GOPHR_ZB_FLUSH_TIMEOUT_MS, GOPHR_ZB_FLUSH_RETRIES) != ESP_OK) {
+        s_reported_valid = false;
+        return false;
+    }
+    return true;
+}
 
-    /* Moisture 1-3 */
-    for (int i = 0; i < 3; i++) {
-        report.zcl_basic_cmd.src_endpoint = GOPHR_EP_MOISTURE_1 + i;
-        report.clusterID = ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT;
-        report.attributeID = ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID;
-        esp_zb_zcl_report_attr_cmd_req(&report);
+esp_err_t gophr_zigbee_flush_reports(uint32_t timeout_ms, int retries)
+{
+    /* The coordinator already confirmed exactly these values */
+    if (s_reported_confirmed && !report_moved(0)) {
+        ESP_LOGD(TAG, "Report already confirmed, nothing to flush");
+        return ESP_OK;
     }
+    return deliver_report(timeout_ms, retries);
+}
 
-    esp_zb_lock_release();
-    ESP_LOGI(TAG, "Reported all attributes");
+esp_err_t gophr_zigbee_send_backlog(const gophr_sample_t *samples, int count)
+{
+    if (count > GOPHR_ZB_BACKLOG_PER_FRAME) count = GOPHR_ZB_BACKLOG_PER_FRAME;
+    s_backlog_len = gophr_samplelog_pack(s_backlog_payload, sizeof(s_backlog_payload),
+                                         (uint32_t)time(NULL), samples, count);
+    if (!s_backlog_len) return ESP_ERR_INVALID_ARG;
+
+    return deliver(send_backlog, "backlog", GOPHR_ZB_FLUSH_TIMEOUT_MS, GOPHR_ZB_FLUSH_RETRIES);
 }
 
 /* ---------- Network Signal Handler ---------- */
@@ -325,6 +607,8 @@ void gophr_zigbee_signal_handler(esp_zb_app_signal_t *signal_struct)
             } else {
                 ESP_LOGI(TAG, "Device rebooted, already on network");
                 s_joined = true;
+                gophr_trace_mark(GOPHR_PHASE_JOINED);
+                gophr_ota_mark_valid();
                 /* Set LED green to indicate connected */
                 gophr_led_set_color(0, 76, 0); /* ~30% green */
             }
@@ -346,6 +630,8 @@ void gophr_zigbee_signal_handler(esp_zb_app_signal_t *signal_struct)
                      extended_pan_id[3], extended_pan_id[2], extended_pan_id[1], extended_pan_id[0],
                      esp_zb_get_pan_id(), esp_zb_get_current_channel(), esp_zb_get_short_address());
             s_joined = true;
+            gophr_trace_mark(GOPHR_PHASE_JOINED);
+            gophr_ota_mark_valid();
             gophr_led_set_color(0, 76, 0); /* Green = connected */
         } else {
             ESP_LOGI(TAG, "Network steering failed (status: %s), retrying...",
@@ -355,6 +641,11 @@ void gophr_zigbee_signal_handler(esp_zb_app_signal_t *signal_struct)
         }
         break;
 
+    case ESP_ZB_COMMON_SIGNAL_CAN_SLEEP:
+        /* Sleepy end device: nothing queued until the next poll */
+        esp_zb_sleep_now();
+        break;
+
     default:
         ESP_LOGI(TAG, "ZDO signal: %s (0x%x), status: %s",
                  esp_zb_zdo_signal_to_string(sig_type), sig_type,
@@ -2,28 +2,55 @@
 
 #include "esp_err.h"
 #include "esp_zigbee_core.h"
+#include "gophr_samplelog.h"
+#include "gophr_energy.h"
 #include <stdbool.h>
 
-/* ---------- Endpoint IDs ---------- */
-#define GOPHR_EP_TEMP           1   /* Temperature + Basic + Power Config */
-#define GOPHR_EP_HUMIDITY       2   /* AHT20 Humidity */
-#define GOPHR_EP_MOISTURE_1     3   /* Soil Moisture 1 (as humidity %) */
-#define GOPHR_EP_MOISTURE_2     4   /* Soil Moisture 2 (as humidity %) */
-#define GOPHR_EP_MOISTURE_3     5   /* Soil Moisture 3 (as humidity %) */
+/* ---------- Endpoint ---------- */
+#define GOPHR_EP                1   /* Basic + Identify + Power Config + Gophr Soil + OTA */
+
+/* ---------- Gophr Soil Cluster (manufacturer-specific) ---------- */
+#define GOPHR_MANUFACTURER_CODE     0x131B  /* Espressif */
+#define GOPHR_CLUSTER_ID_SOIL       0xFC00
+#define GOPHR_ATTR_SOIL_MOISTURE_1  0x0000  /* uint16, 0.01% */
+#define GOPHR_ATTR_SOIL_MOISTURE_2  0x0001  /* uint16, 0.01% */
+#define GOPHR_ATTR_SOIL_MOISTURE_3  0x0002  /* uint16, 0.01% */
+#define GOPHR_ATTR_SOIL_TEMPERATURE 0x0010  /* int16, 0.01°C (AHT20) */
+#define GOPHR_ATTR_SOIL_HUMIDITY    0x0011  /* uint16, 0.01% (AHT20) */
+
+/* Energy ledger diagnostics (gophr_energy.h), read on demand, not in the aggregated report */
+#define GOPHR_ATTR_ENERGY_CYCLE     0x0020  /* uint32, uAh of the last wake cycle */
+#define GOPHR_ATTR_ENERGY_TODAY     0x0021  /* uint32, uAh so far in the current 24h */
+#define GOPHR_ATTR_ENERGY_DAY       0x0022  /* uint32, uAh of the last complete 24h */
+
+/* Server -> client: samples logged while off the network (gophr_samplelog_pack format) */
+#define GOPHR_CMD_SOIL_BACKLOG      0x00
+#define GOPHR_ZB_BACKLOG_PER_FRAME  3       /* Keeps the frame unfragmented */
+
+/* Aggregated reports go straight to the coordinator */
+#define GOPHR_REPORT_DST_ADDR   0x0000
+#define GOPHR_REPORT_DST_EP     1
+
+/* Change since the last aggregated report that sends a new one while awake */
+#define GOPHR_TEMP_REPORT_DELTA     50    /* 0.5°C */
+#define GOPHR_HUMIDITY_REPORT_DELTA 100   /* 1.0% (humidity and moisture) */
 
 /* ---------- Device Info ---------- */
 #define GOPHR_MANUFACTURER_NAME "\x05""GOPHR"       /* ZCL string: length-prefixed */
 #define GOPHR_MODEL_IDENTIFIER  "\x08""Gophr-C6"
 
 /* ---------- ZED Configuration ---------- */
-#define GOPHR_ZED_TIMEOUT       ESP_ZB_ZED_TIMEOUT_64MIN
+#define GOPHR_ZED_TIMEOUT       ESP_ZB_ZED_TIMEOUT_512MIN    /* Outlasts skipped wakes (gophr_wakegate.h) */
+/* Parent poll interval while rx is off when idle; override with -DGOPHR_ZED_KEEP_ALIVE=N */
+#ifndef GOPHR_ZED_KEEP_ALIVE
 #define GOPHR_ZED_KEEP_ALIVE    3000  /* ms */
+#endif
 
-/* ---------- Reporting Intervals ---------- */
-#define GOPHR_REPORT_MIN_INTERVAL   1     /* seconds */
-#define GOPHR_REPORT_MAX_INTERVAL   0     /* 0 = report on change only */
-#define GOPHR_TEMP_REPORT_DELTA     50    /* 0.5°C change triggers report */
-#define GOPHR_HUMIDITY_REPORT_DELTA 100   /* 1.0% change triggers report */
+/* ---------- Report Flush ---------- */
+#define GOPHR_ZB_FLUSH_TIMEOUT_MS   3000  /* Total budget before sleeping anyway */
+#define GOPHR_ZB_FLUSH_RETRIES      2     /* Resends per report */
+#define GOPHR_ZB_FLUSH_RSP_GRACE_MS 250   /* Wait for the default response after the APS ack */
+#define GOPHR_ZB_FLUSH_POLL_MS      20
 
 /* ---------- Zigbee Channel ---------- */
 #define GOPHR_CHANNEL_MASK      ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK
@@ -44,20 +71,43 @@
 /* Create all Zigbee endpoints and clusters, register the device */
 esp_err_t gophr_zigbee_create_device(void);
 
-/* Update temperature attribute (Celsius) */
-void gophr_zigbee_update_temperature(float celsius);
-
-/* Update AHT20 humidity attribute (%) */
-void gophr_zigbee_update_humidity(float percent);
-
-/* Update soil moisture attribute (%) for sensor 0-2 */
-void gophr_zigbee_update_moisture(int sensor_index, float percent);
-
-/* Update battery attributes */
-void gophr_zigbee_update_battery(float voltage, float percent);
-
-/* Send report for all attributes */
-void gophr_zigbee_report_all(void);
+/*
+ * Staged attribute updates (call from one task). stage_* only records the
+ * value; gophr_zigbee_commit() writes every staged attribute that differs
+ * from the last written value under a single stack lock and returns how
+ * many were written. A write the stack rejects is retried on the next
+ * commit, even with the same value.
+ */
+void gophr_zigbee_stage_temperature(float celsius);
+void gophr_zigbee_stage_humidity(float percent);
+void gophr_zigbee_stage_moisture(int sensor_index, float percent);
+void gophr_zigbee_stage_battery(float voltage, float percent);
+void gophr_zigbee_stage_energy(const gophr_energy_summary_t *energy);
+int gophr_zigbee_commit(void);
+
+/*
+ * Send all soil cluster attributes in one Report Attributes frame if any of
+ * them moved past its report delta since the last aggregated report (call
+ * after gophr_zigbee_commit()), and block until it is confirmed like
+ * gophr_zigbee_flush_reports(). Returns true only for a confirmed frame; an
+ * unconfirmed one is sent again on the next call.
+ */
+bool gophr_zigbee_report_changed(void);
+
+/*
+ * Send the aggregated report and block until it is confirmed by a ZCL
+ * default response (or at least an APS ack), resending a lost frame up to
+ * `retries` times. Returns ESP_ERR_TIMEOUT if it was not delivered, and
+ * ESP_OK without sending if the last report was confirmed and no value
+ * changed since.
+ */
+esp_err_t gophr_zigbee_flush_reports(uint32_t timeout_ms, int retries);
+
+/*
+ * Send up to GOPHR_ZB_BACKLOG_PER_FRAME logged samples in one Backlog
+ * command and block until delivered, like gophr_zigbee_flush_reports().
+ */
+esp_err_t gophr_zigbee_send_backlog(const gophr_sample_t *samples, int count);
 
 /* Zigbee signal handler (called by stack) */
 void gophr_zigbee_signal_handler(esp_zb_app_signal_t *signal_struct);